@@ -0,0 +1,151 @@
+#include "tell/alloc.h"
+#include <cstdlib>
+#include <new>
+
+// replacements of the global operator new and delete: they count the
+// allocations of each thread for Alloc_counter and otherwise defer to
+// malloc and free
+
+namespace
+{
+  thread_local tell::Alloc_sample count;
+
+  void* allocate(std::size_t n)
+  {
+    ++count.allocations;
+    count.bytes += n;
+    return std::malloc(n == 0 ? 1 : n);
+  }
+
+  void* allocate(std::size_t n, std::align_val_t a)
+  {
+    ++count.allocations;
+    count.bytes += n;
+    void* p = nullptr;
+    const auto al = std::max(static_cast<std::size_t>(a), sizeof(void*));
+    return posix_memalign(&p, al, n == 0 ? 1 : n) == 0 ? p : nullptr;
+  }
+
+  template<typename... A>
+    void* allocate_or_throw(std::size_t n, A... a)
+  {
+    for (;;) {
+      if (void* p = allocate(n, a...)) {
+	return p;
+      }
+      const auto h = std::get_new_handler();
+      if (!h) {
+	throw std::bad_alloc();
+      }
+      h();
+    }
+  }
+}
+
+const tell::Alloc_sample& tell::impl::alloc_count()
+{
+  return count;
+}
+
+void* operator new(std::size_t n)
+{
+  return allocate_or_throw(n);
+}
+
+void* operator new[](std::size_t n)
+{
+  return allocate_or_throw(n);
+}
+
+void* operator new(std::size_t n, std::align_val_t a)
+{
+  return allocate_or_throw(n, a);
+}
+
+void* operator new[](std::size_t n, std::align_val_t a)
+{
+  return allocate_or_throw(n, a);
+}
+
+void* operator new(std::size_t n, const std::nothrow_t&) noexcept
+{
+  return allocate(n);
+}
+
+void* operator new[](std::size_t n, const std::nothrow_t&) noexcept
+{
+  return allocate(n);
+}
+
+void* operator new(std::size_t n, std::align_val_t a,
+		   const std::nothrow_t&) noexcept
+{
+  return allocate(n, a);
+}
+
+void* operator new[](std::size_t n, std::align_val_t a,
+		     const std::nothrow_t&) noexcept
+{
+  return allocate(n, a);
+}
+
+void operator delete(void* p) noexcept
+{
+  std::free(p);
+}
+
+void operator delete[](void* p) noexcept
+{
+  std::free(p);
+}
+
+void operator delete(void* p, std::size_t) noexcept
+{
+  std::free(p);
+}
+
+void operator delete[](void* p, std::size_t) noexcept
+{
+  std::free(p);
+}
+
+void operator delete(void* p, std::align_val_t) noexcept
+{
+  std::free(p);
+}
+
+void operator delete[](void* p, std::align_val_t) noexcept
+{
+  std::free(p);
+}
+
+void operator delete(void* p, std::size_t, std::align_val_t) noexcept
+{
+  std::free(p);
+}
+
+void operator delete[](void* p, std::size_t, std::align_val_t) noexcept
+{
+  std::free(p);
+}
+
+void operator delete(void* p, const std::nothrow_t&) noexcept
+{
+  std::free(p);
+}
+
+void operator delete[](void* p, const std::nothrow_t&) noexcept
+{
+  std::free(p);
+}
+
+void operator delete(void* p, std::align_val_t, const std::nothrow_t&) noexcept
+{
+  std::free(p);
+}
+
+void operator delete[](void* p, std::align_val_t,
+		       const std::nothrow_t&) noexcept
+{
+  std::free(p);
+}
@@ -0,0 +1,90 @@
+#pragma once
+
+#include <tell/util.h>
+
+#include <cstddef>
+#include <iomanip>
+#include <iostream>
+
+//
+// heap allocations of Timer scopes, counted by the operator new
+// replacements in the tell_alloc library (src/alloc.cc), which only
+// programs that use Alloc_counter link
+//
+
+namespace tell
+{
+  // allocations of the calling thread, or their increase over a scope
+  struct Alloc_sample
+  {
+    std::size_t allocations = 0;
+    std::size_t bytes = 0;
+  };
+
+  namespace impl
+  {
+    // running totals of the calling thread
+    const Alloc_sample& alloc_count();
+  }
+
+  // per call statistics of the allocations
+  struct Alloc_stats
+  {
+    Alloc_stats& operator<<(const Alloc_sample& x);
+    Alloc_stats& operator+=(const Alloc_stats& s);
+    Avg allocations;
+    Avg bytes;
+  };
+
+  // Timer probe counting the heap allocations of the thread within a
+  // scope, e.g. Timer<std::chrono::microseconds, Avg, Tsc_clock,
+  // Alloc_counter>; frees are not counted, nor allocations made by
+  // other threads on behalf of the scope
+  class Alloc_counter
+  {
+  public:
+    using Sample = Alloc_sample;
+    using Acc = Alloc_stats;
+    Alloc_counter();
+    bool stop(Sample& x);
+    static std::ostream& print(std::ostream&, const Acc&);
+  private:
+    Sample start;
+  };
+}
+
+inline tell::Alloc_stats& tell::Alloc_stats::operator<<(const Alloc_sample& x)
+{
+  allocations << x.allocations;
+  bytes << x.bytes;
+  return *this;
+}
+
+inline tell::Alloc_stats& tell::Alloc_stats::operator+=(const Alloc_stats& s)
+{
+  allocations += s.allocations;
+  bytes += s.bytes;
+  return *this;
+}
+
+inline tell::Alloc_counter::Alloc_counter()
+: start(impl::alloc_count())
+{
+}
+
+inline bool tell::Alloc_counter::stop(Sample& x)
+{
+  const auto& end = impl::alloc_count();
+  x = {end.allocations - start.allocations, end.bytes - start.bytes};
+  return true;
+}
+
+inline std::ostream&
+tell::Alloc_counter::print(std::ostream& ost, const Acc& s)
+{
+  Ios_saver guard(ost);
+  return ost
+    << " allocs/call" << std::right << std::setw(10) << std::setprecision(3)
+    << s.allocations().first
+    << " bytes/call" << std::setw(12) << s.bytes().first;
+}
@@ -0,0 +1,128 @@
+#pragma once
+
+#include <tell/util.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <iomanip>
+#include <iostream>
+#include <limits>
+#include <vector>
+
+//
+// micro-benchmarks: calibrated batches timed like Timer scopes,
+// outliers rejected, statistics with Avg
+//
+
+namespace tell
+{
+  // keep the compiler from optimising away x or the work producing it
+  template<typename T>
+    void do_not_optimize(const T& x);
+
+  // keep the compiler from optimising away stores to memory
+  void clobber_memory();
+
+  struct Bench_config
+  {
+    // a batch of iterations is grown until it runs at least this long
+    std::chrono::nanoseconds sample_time = std::chrono::milliseconds(10);
+    std::size_t samples = 30;
+    std::chrono::nanoseconds warmup = std::chrono::milliseconds(100);
+  };
+
+  struct Bench_result
+  {
+    const char* label;
+    std::size_t iterations;// per sample
+    std::size_t samples;// kept after outlier rejection
+    std::size_t rejected;
+    Avg ns;// per iteration
+    double median;// per iteration, in ns
+  };
+
+  // run f in batches: after a warmup the batch size is doubled until a
+  // batch takes sample_time, then samples batches are timed and those
+  // outside Tukey's fences (1.5 interquartile ranges) are dropped; a
+  // body the compiler removed never takes sample_time, so doubling also
+  // stops after 16 in a row that didn't lengthen the batch, or at half
+  // the range of std::size_t
+  template<typename Clock = std::chrono::steady_clock, typename F>
+    Bench_result bench(const char* label, F f, const Bench_config& c = {});
+
+  std::ostream& operator<<(std::ostream&, const Bench_result&);
+}
+
+template<typename T>
+inline void tell::do_not_optimize(const T& x)
+{
+  asm volatile("" : : "r,m"(x) : "memory");
+}
+
+inline void tell::clobber_memory()
+{
+  asm volatile("" : : : "memory");
+}
+
+template<typename Clock, typename F>
+tell::Bench_result
+tell::bench(const char* label, F f, const Bench_config& c)
+{
+  using namespace std::chrono;
+  const auto batch = [&f](std::size_t n) {
+    const auto t = Clock::now();
+    for (std::size_t i = 0; i != n; ++i) {
+      f();
+    }
+    return std::max(Clock::now() - t - clock_overhead<Clock>,
+		    Clock::duration::zero());
+  };
+  for (const auto t = Clock::now(); Clock::now() - t < c.warmup; ) {
+    batch(1);
+  }
+  std::size_t n = 1;
+  auto d = batch(n);
+  for (int flat = 0; d < c.sample_time && flat != 16
+	 && n < std::numeric_limits<std::size_t>::max()/2; ) {
+    n *= 2;
+    const auto e = batch(n);
+    flat = e <= d ? flat + 1 : 0;
+    d = e;
+  }
+  std::vector<double> x(c.samples);
+  for (auto& y : x) {
+    y = duration<double, std::nano>(batch(n)).count()/n;
+  }
+  auto s = x;
+  std::sort(s.begin(), s.end());
+  const auto q = [&s](double p) {
+    return s.empty() ? 0.0 : s[static_cast<std::size_t>(p*(s.size() - 1))];
+  };
+  const double iqr = q(0.75) - q(0.25);
+  const double lo = q(0.25) - 1.5*iqr;
+  const double hi = q(0.75) + 1.5*iqr;
+  Bench_result r{label, n, 0, 0, {}, q(0.5)};
+  for (const auto y : x) {
+    if (y < lo || hi < y) {
+      ++r.rejected;
+    }
+    else {
+      r.ns << y;
+      ++r.samples;
+    }
+  }
+  return r;
+}
+
+inline std::ostream& tell::operator<<(std::ostream& ost, const Bench_result& r)
+{
+  double mu, sigma;
+  std::tie(mu, sigma) = r.ns();
+  return ost
+    << "bench for " << std::left << std::setw(28) << r.label << std::right
+    << std::setw(12) << mu << "ns +-" << std::setw(10) << sigma
+    << " median" << std::setw(12) << r.median << "ns"
+    << " (" << r.samples << " samples of " << r.iterations
+    << ", " << r.rejected << " rejected)";
+}
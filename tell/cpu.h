@@ -0,0 +1,105 @@
+#pragma once
+
+#include <tell/util.h>
+
+#include <cstdint>
+#include <iomanip>
+#include <iostream>
+
+#include <time.h>
+
+//
+// thread CPU time of Timer scopes, against their wall time
+//
+
+namespace tell
+{
+  // CPU time of the calling thread and wall time, or their increase
+  // over a scope, in nanoseconds
+  struct Cpu_sample
+  {
+    std::int64_t cpu = 0;
+    std::int64_t wall = 0;
+  };
+
+  // per call statistics of CPU and wall time
+  struct Cpu_stats
+  {
+    Cpu_stats& operator<<(const Cpu_sample& x);
+    Cpu_stats& operator+=(const Cpu_stats& s);
+    // share of the wall time the thread was running, over all calls
+    double ratio() const;
+    Avg cpu;
+    Avg wall;
+  };
+
+  // Timer probe reading CLOCK_THREAD_CPUTIME_ID and CLOCK_MONOTONIC at
+  // scope entry and exit, e.g. Timer<std::chrono::microseconds, Avg,
+  // Tsc_clock, Cpu_time>; a ratio well below 1 means the scope waited
+  // on locks, I/O or the scheduler rather than computing
+  class Cpu_time
+  {
+  public:
+    using Sample = Cpu_sample;
+    using Acc = Cpu_stats;
+    Cpu_time();
+    bool stop(Sample& x);
+    static std::ostream& print(std::ostream&, const Acc&);
+  private:
+    static Sample now();
+    Sample start;
+  };
+}
+
+inline tell::Cpu_stats& tell::Cpu_stats::operator<<(const Cpu_sample& x)
+{
+  cpu << x.cpu;
+  wall << x.wall;
+  return *this;
+}
+
+inline tell::Cpu_stats& tell::Cpu_stats::operator+=(const Cpu_stats& s)
+{
+  cpu += s.cpu;
+  wall += s.wall;
+  return *this;
+}
+
+inline double tell::Cpu_stats::ratio() const
+{
+  const double w = wall().first;
+  return w == 0 ? 0.0 : cpu().first/w;
+}
+
+inline tell::Cpu_sample tell::Cpu_time::now()
+{
+  const auto ns = [](clockid_t id) {
+    timespec ts;
+    clock_gettime(id, &ts);
+    return std::int64_t{ts.tv_sec}*1000000000 + ts.tv_nsec;
+  };
+  return {ns(CLOCK_THREAD_CPUTIME_ID), ns(CLOCK_MONOTONIC)};
+}
+
+inline tell::Cpu_time::Cpu_time()
+: start(now())
+{
+}
+
+inline bool tell::Cpu_time::stop(Sample& x)
+{
+  const auto end = now();
+  x = {end.cpu - start.cpu, end.wall - start.wall};
+  return true;
+}
+
+inline std::ostream& tell::Cpu_time::print(std::ostream& ost, const Acc& s)
+{
+  Ios_saver guard(ost);
+  return ost
+    << std::fixed << std::setprecision(0)
+    << " cpu" << std::right << std::setw(12) << s.cpu().first << "ns"
+    << " wall" << std::setw(12) << s.wall().first << "ns"
+    << std::setprecision(3)
+    << " cpu/wall" << std::setw(7) << s.ratio();
+}
@@ -0,0 +1,128 @@
+#pragma once
+
+#include <tell/util.h>
+
+#include <cstdint>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+
+#include <fcntl.h>
+#include <sys/resource.h>
+#include <unistd.h>
+
+//
+// page faults and resident set growth of Timer scopes
+//
+
+namespace tell
+{
+  // fault counts of the calling thread and resident set size of the
+  // process, or their increase over a scope
+  struct Fault_sample
+  {
+    std::int64_t minor = 0;
+    std::int64_t major = 0;
+    std::int64_t rss = 0;// bytes
+  };
+
+  // per call statistics of the faults and RSS growth
+  struct Fault_stats
+  {
+    Fault_stats& operator<<(const Fault_sample& x);
+    Fault_stats& operator+=(const Fault_stats& s);
+    Avg minor;
+    Avg major;
+    Avg rss;
+  };
+
+  // Timer probe reading the minor and major page faults of the thread
+  // (getrusage) and the resident set of the process (/proc/self/statm)
+  // at scope entry and exit, e.g. Timer<std::chrono::microseconds, Avg,
+  // Tsc_clock, Fault_counter>; a scope that faults on every call is
+  // first touching memory rather than computing; RSS is process wide,
+  // so other threads' growth shows as well
+  class Fault_counter
+  {
+  public:
+    using Sample = Fault_sample;
+    using Acc = Fault_stats;
+    Fault_counter();
+    bool stop(Sample& x);
+    static std::ostream& print(std::ostream&, const Acc&);
+  private:
+    static bool read(Sample& x);
+    static std::int64_t rss();
+    Sample start;
+    bool valid;
+  };
+}
+
+inline tell::Fault_stats& tell::Fault_stats::operator<<(const Fault_sample& x)
+{
+  minor << x.minor;
+  major << x.major;
+  rss << x.rss;
+  return *this;
+}
+
+inline tell::Fault_stats& tell::Fault_stats::operator+=(const Fault_stats& s)
+{
+  minor += s.minor;
+  major += s.major;
+  rss += s.rss;
+  return *this;
+}
+
+inline std::int64_t tell::Fault_counter::rss()
+{
+  // opened once, read with pread at offset 0: no reopen per scope
+  static const int fd = open("/proc/self/statm", O_RDONLY | O_CLOEXEC);
+  static const long page = sysconf(_SC_PAGESIZE);
+  char buf[128];
+  const auto n = fd < 0 ? -1 : pread(fd, buf, sizeof(buf) - 1, 0);
+  if (n <= 0) {
+    return -1;
+  }
+  buf[n] = '\0';
+  // size resident shared text lib data dt, in pages
+  char* end;
+  std::strtoll(buf, &end, 10);
+  return std::strtoll(end, nullptr, 10)*page;
+}
+
+inline bool tell::Fault_counter::read(Sample& x)
+{
+  rusage u;
+  if (getrusage(RUSAGE_THREAD, &u) != 0) {
+    return false;
+  }
+  x = {u.ru_minflt, u.ru_majflt, rss()};
+  return 0 <= x.rss;
+}
+
+inline tell::Fault_counter::Fault_counter()
+: valid(read(start))
+{
+}
+
+inline bool tell::Fault_counter::stop(Sample& x)
+{
+  Sample end;
+  if (!valid || !read(end)) {
+    return false;
+  }
+  x = {end.minor - start.minor, end.major - start.major, end.rss - start.rss};
+  return true;
+}
+
+inline std::ostream&
+tell::Fault_counter::print(std::ostream& ost, const Acc& s)
+{
+  Ios_saver guard(ost);
+  return ost
+    << " minor-faults/call" << std::right << std::setw(10)
+    << std::setprecision(3) << s.minor().first
+    << " major-faults/call" << std::setw(8) << s.major().first
+    << " rss-growth/call" << std::setw(12) << s.rss().first << 'B';
+}
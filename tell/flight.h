@@ -0,0 +1,231 @@
+#pragma once
+
+#include <tell/util.h>
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <string>
+
+//
+// flight recorder for slow scopes: context of outliers, kept per thread
+//
+
+namespace tell
+{
+  // Timer with a latency budget: every thread remembers the last depth
+  // Flight_timer scopes that ended, with their durations and nesting;
+  // a scope that takes longer than its budget copies the scopes nested
+  // in it from there, together with its own label, duration and tag,
+  // into the thread's ring of the last records slow scopes, which
+  // dump() writes out; scopes within budget pay for a few stores only;
+  // the ring of a thread that exited goes to the next new thread, every
+  // record carries the number of the thread that made it;
+  // compile-time labels ("parse"_S) are recorded by array index, and a
+  // scope switched off does not touch its thread's recorder
+  template<std::size_t depth = 16, std::size_t records = 32,
+    typename P = std::chrono::microseconds, typename Acc = Avg,
+    typename Clock = std::chrono::high_resolution_clock>
+    class Flight_timer
+    {
+      using Stats = impl::Sharded<Flight_timer, Acc>;
+    public:
+      using duration = P;
+      Flight_timer(const char* label = "run", P budget = P::max(),
+		   std::int64_t tag = 0);
+      template<char... C> Flight_timer(ct_string<C...> label,
+				       P budget = P::max(),
+				       std::int64_t tag = 0);
+      ~Flight_timer();
+      Flight_timer(const Flight_timer&) = delete;
+      Flight_timer& operator=(const Flight_timer&) = delete;
+      static std::map<std::string, Acc> stats();
+      static std::ostream& print_stats(std::ostream&, bool seqno = false);
+      // slow scopes recorded by all threads, oldest first per thread
+      static std::ostream& dump(std::ostream&);
+    private:
+      // duration in units of P
+      struct Scope
+      {
+	const char* label;
+	double d;
+	unsigned level;
+      };
+      struct Record
+      {
+	Scope slow;
+	double budget;
+	std::int64_t tag;
+	int tid;
+	std::size_t n;
+	std::array<Scope, depth> inner;// oldest first
+      };
+      // owned by one thread; the ring is locked only to record a slow
+      // scope and to dump
+      struct Recorder
+      {
+	void record(const Scope& slow, double budget, std::int64_t tag,
+		    int tid);
+	unsigned level = 0;
+	std::size_t ended = 0;
+	std::array<Scope, depth> recent;
+	std::mutex mutex;
+	std::size_t written = 0;
+	std::array<Record, records> ring;
+      };
+      // recorders outlive their threads so that they can be dumped later
+      using Recorders = impl::Recycled<Recorder>;
+      void start();
+      const char* const label;
+      const std::size_t slot = impl::Labels::none;
+      const double budget;
+      const std::int64_t tag;
+      const bool on = impl::active(label);
+      // none for a scope switched off
+      Recorder* const rec = on ? Recorders::local().object : nullptr;
+      typename Clock::time_point t;
+    };
+}
+
+template<std::size_t depth, std::size_t records, typename P, typename Acc,
+  typename Clock>
+void tell::Flight_timer<depth,records,P,Acc,Clock>::Recorder::record(
+  const Scope& slow, double budget, std::int64_t tag, int tid)
+{
+  std::lock_guard<std::mutex> lock(mutex);
+  auto& r = ring[written++ % records];
+  r.slow = slow;
+  r.budget = budget;
+  r.tag = tag;
+  r.tid = tid;
+  r.n = 0;
+  // scopes that ended since slow began are nested deeper, the first
+  // one at its level or above ended before it
+  for (auto i = ended; i != 0 && i + depth != ended; --i) {
+    const auto& s = recent[(i-1) % depth];
+    if (s.level <= slow.level) {
+      break;
+    }
+    r.inner[r.n++] = s;
+  }
+  std::reverse(r.inner.begin(), r.inner.begin() + r.n);
+}
+
+template<std::size_t depth, std::size_t records, typename P, typename Acc,
+  typename Clock>
+tell::Flight_timer<depth,records,P,Acc,Clock>::Flight_timer(const char* label,
+							    P budget,
+							    std::int64_t tag)
+: label(label)
+, budget(std::chrono::duration<double, typename P::period>(budget).count())
+, tag(tag)
+{
+  start();
+}
+
+template<std::size_t depth, std::size_t records, typename P, typename Acc,
+  typename Clock>
+template<char... C>
+tell::Flight_timer<depth,records,P,Acc,Clock>::Flight_timer(ct_string<C...> label,
+							    P budget,
+							    std::int64_t tag)
+: label(label.c_str())
+, slot(impl::label_slot<ct_string<C...>>())
+, budget(std::chrono::duration<double, typename P::period>(budget).count())
+, tag(tag)
+{
+  start();
+}
+
+template<std::size_t depth, std::size_t records, typename P, typename Acc,
+  typename Clock>
+void tell::Flight_timer<depth,records,P,Acc,Clock>::start()
+{
+  if (on) {
+    ++rec->level;
+    t = Clock::now();
+  }
+}
+
+template<std::size_t depth, std::size_t records, typename P, typename Acc,
+  typename Clock>
+tell::Flight_timer<depth,records,P,Acc,Clock>::~Flight_timer()
+{
+  if (!on) {
+    return;
+  }
+  const auto d = std::max(Clock::now() - t - clock_overhead<Clock>,
+			  Clock::duration::zero());
+  impl::call_scope_hook(label, d);
+  const double x = std::chrono::duration<double, typename P::period>(d).count();
+  if (slot == impl::Labels::none) {
+    Stats::add(label, x);
+  }
+  else {
+    Stats::add(slot, x);
+  }
+  const Scope s{label, x, --rec->level};
+  if (budget < x) {
+    rec->record(s, budget, tag, Recorders::local().tid);
+  }
+  rec->recent[rec->ended++ % depth] = s;
+}
+
+template<std::size_t depth, std::size_t records, typename P, typename Acc,
+  typename Clock>
+std::map<std::string, Acc> tell::Flight_timer<depth,records,P,Acc,Clock>::stats()
+{
+  return Stats::merge();
+}
+
+template<std::size_t depth, std::size_t records, typename P, typename Acc,
+  typename Clock>
+std::ostream&
+tell::Flight_timer<depth,records,P,Acc,Clock>::print_stats(std::ostream& ost,
+							   bool seqno)
+{
+  std::size_t i = 0;
+  for (const auto& p : stats()) {
+    ost
+      << "timing for " << std::right << std::setw(10) << p.first;
+    if (seqno) {
+      ost
+	<< " (" << std::right << std::setw(2) << i++ << ')';
+    }
+    impl::print_stat(ost, p.second, precision<P>) << '\n';
+  }
+  return ost;
+}
+
+template<std::size_t depth, std::size_t records, typename P, typename Acc,
+  typename Clock>
+std::ostream&
+tell::Flight_timer<depth,records,P,Acc,Clock>::dump(std::ostream& ost)
+{
+  Recorders::for_each([&ost](Recorder& rec) {
+    std::lock_guard<std::mutex> lock(rec.mutex);
+    const auto n = std::min(rec.written, records);
+    for (auto i = rec.written - n; i != rec.written; ++i) {
+      const auto& r = rec.ring[i % records];
+      ost
+	<< "slow scope " << std::left << std::setw(16) << r.slow.label
+	<< std::right << std::setw(12) << r.slow.d << precision<P>
+	<< " budget " << r.budget << precision<P>
+	<< " tag " << r.tag << " thread " << r.tid << '\n';
+      for (std::size_t j = 0; j != r.n; ++j) {
+	const auto& s = r.inner[j];
+	const auto indent = 2*(s.level - r.slow.level);
+	ost
+	  << std::string(indent, ' ') << std::left
+	  << std::setw(std::max<int>(1, 26 - indent)) << s.label
+	  << std::right << std::setw(12) << s.d << precision<P> << '\n';
+      }
+    }
+  });
+  return ost;
+}
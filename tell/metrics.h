@@ -0,0 +1,323 @@
+#pragma once
+
+#include <tell/util.h>
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+//
+// periodic OpenMetrics export of Timer, Counter and Histo statistics
+//
+
+namespace tell
+{
+  namespace impl
+  {
+    // whether T estimates its calls, as Sampled_timer does
+    template<typename T, typename = void>
+      constexpr bool has_calls = false;
+    template<typename T>
+      constexpr bool has_calls<T, std::void_t<decltype(T::calls())>> = true;
+  }
+
+  // snapshots the registered sources and all Counters at an interval and
+  // rewrites a text file in OpenMetrics format, as read by the textfile
+  // collector of node-exporter; the file is written next to its target
+  // and renamed over it, so that scrapers never see it half written;
+  // values are deltas over the last window, i.e. current load rather
+  // than totals since the start, and hence exported as gauges; timers
+  // with Window_avg or Decayed_avg export their own window or decayed
+  // weight as of the write instead, in families of their own
+  class Metrics_export
+  {
+  public:
+    // export a timer type, e.g. add<Timer<>>("request"); calls and
+    // seconds spent per label, estimated from the samples taken for
+    // a Sampled_timer
+    template<typename T>
+      static void add(const char* name);
+    // export a histogram, read under the lock that guards its updates
+    template<typename H>
+      static void add(const char* name, const H& h, std::mutex& m);
+    // stop exporting name, e.g. before the histogram goes out of scope
+    static void remove(const std::string& name);
+    static void start(const std::string& path,
+		      std::chrono::milliseconds interval
+		      = std::chrono::seconds(15));
+    // write a last window and stop the exporter thread
+    static void stop();
+    // close the current window and write it to ost
+    static std::ostream& write(std::ostream& ost);
+  private:
+    // metric family and label set of one value
+    using Key = std::pair<std::string, std::string>;
+    using Values = std::map<Key, double>;
+    using Source = std::function<void(Values&)>;
+    struct Exporter
+    {
+      ~Exporter();
+      void halt();
+      std::mutex mutex;
+      std::vector<std::pair<std::string, Source>> sources;
+      Values last;// totals at the end of the previous window
+      std::condition_variable wake;
+      bool running = false;
+      std::string path;
+      std::chrono::milliseconds interval{0};
+      std::thread thread;
+    };
+    static Exporter& exporter();
+    static std::string quote(const std::string& s);
+    static void totals(Values& v, const std::string& l, const Avg& a,
+		       double unit);
+    static void totals(Values& v, const std::string& l,
+		       const Latency_histo& h, double unit);
+    template<std::size_t slots, std::int64_t width_ms>
+      static void totals(Values& v, const std::string& l,
+			 const Window_avg<slots,width_ms>& w, double unit);
+    template<std::int64_t half_life_ms>
+      static void totals(Values& v, const std::string& l,
+			 const Decayed_avg<half_life_ms>& d, double unit);
+    // whether values of family are current already, not totals
+    static bool current(const std::string& family);
+    template<typename A, typename B>
+      static void totals(Values& v, const std::string& l, const Both<A,B>& b,
+			 double unit);
+    static void write_file(const std::string& path);
+    static void run();
+  };
+}
+
+template<typename T>
+void tell::Metrics_export::add(const char* name)
+{
+  auto& e = exporter();
+  std::lock_guard<std::mutex> lock(e.mutex);
+  e.sources.emplace_back(name, [name](Values& v) {
+      using R = typename T::duration::period;
+      const double unit = static_cast<double>(R::num)/R::den;
+      [[maybe_unused]] std::map<std::string, double> calls;
+      if constexpr (impl::has_calls<T>) {
+	calls = T::calls();
+      }
+      for (const auto& p : T::stats()) {
+	const auto l = "timer=" + quote(name) + ",label=" + quote(p.first);
+	if constexpr (impl::has_calls<T>) {
+	  // each sample stands for the calls it skipped; a window or decay
+	  // holds recent samples, taken at about the current rate
+	  Values w;
+	  totals(w, l, p.second, unit);
+	  const auto i = w.find({"tell_timer_calls", l});
+	  const double k = i == w.end() ? T::rate()
+	    : i->second == 0 ? 0 : calls[p.first]/i->second;
+	  for (const auto& x : w) {
+	    v[x.first] += k*x.second;
+	  }
+	}
+	else {
+	  totals(v, l, p.second, unit);
+	}
+      }
+    });
+}
+
+template<typename H>
+void tell::Metrics_export::add(const char* name, const H& h, std::mutex& m)
+{
+  auto& e = exporter();
+  std::lock_guard<std::mutex> lock(e.mutex);
+  e.sources.emplace_back(name, [name, &h, &m](Values& v) {
+      std::lock_guard<std::mutex> lock(m);
+      for (const auto& b : h.bins()) {
+	std::ostringstream value;
+	value << b.first;
+	v[{"tell_histo_count", "histo=" + quote(name) + ",value="
+	    + quote(value.str())}] += b.second;
+      }
+    });
+}
+
+inline void tell::Metrics_export::remove(const std::string& name)
+{
+  auto& e = exporter();
+  std::lock_guard<std::mutex> lock(e.mutex);
+  e.sources.erase(std::remove_if(e.sources.begin(), e.sources.end(),
+				 [&name](const auto& s) {
+				   return s.first == name;
+				 }),
+		  e.sources.end());
+}
+
+inline tell::Metrics_export::Exporter::~Exporter()
+{
+  halt();
+}
+
+inline void tell::Metrics_export::Exporter::halt()
+{
+  if (!thread.joinable()) {
+    return;
+  }
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    running = false;
+  }
+  wake.notify_one();
+  thread.join();
+}
+
+inline tell::Metrics_export::Exporter& tell::Metrics_export::exporter()
+{
+  static Exporter e;
+  return e;
+}
+
+inline std::string tell::Metrics_export::quote(const std::string& s)
+{
+  std::string q = "\"";
+  for (const auto c : s) {
+    if (c == '\n') {
+      q += "\\n";
+      continue;
+    }
+    if (c == '"' || c == '\\') {
+      q += '\\';
+    }
+    q += c;
+  }
+  return q + '"';
+}
+
+inline void tell::Metrics_export::totals(Values& v, const std::string& l,
+					  const Avg& a, double unit)
+{
+  v[{"tell_timer_calls", l}] += a.count();
+  v[{"tell_timer_seconds", l}] += a().first*a.count()*unit;
+}
+
+inline void tell::Metrics_export::totals(Values& v, const std::string& l,
+					  const Latency_histo& h, double unit)
+{
+  v[{"tell_timer_calls", l}] += h.count();
+  v[{"tell_timer_seconds", l}] += h.mean()*h.count()*unit;
+}
+
+template<std::size_t slots, std::int64_t width_ms>
+void tell::Metrics_export::totals(Values& v, const std::string& l,
+				  const Window_avg<slots,width_ms>& w,
+				  double unit)
+{
+  const auto a = w.window();
+  v[{"tell_timer_window_calls", l}] += a.count();
+  v[{"tell_timer_window_seconds", l}] += a().first*a.count()*unit;
+}
+
+template<std::int64_t half_life_ms>
+void tell::Metrics_export::totals(Values& v, const std::string& l,
+				  const Decayed_avg<half_life_ms>& d,
+				  double unit)
+{
+  v[{"tell_timer_decayed_calls", l}] += d.weight();
+  v[{"tell_timer_decayed_seconds", l}] += d().first*d.weight()*unit;
+}
+
+template<typename A, typename B>
+void tell::Metrics_export::totals(Values& v, const std::string& l,
+				  const Both<A,B>& b, double unit)
+{
+  totals(v, l, b.first, unit);
+}
+
+inline bool tell::Metrics_export::current(const std::string& family)
+{
+  return family.compare(0, 18, "tell_timer_window_") == 0 ||
+    family.compare(0, 19, "tell_timer_decayed_") == 0;
+}
+
+inline std::ostream& tell::Metrics_export::write(std::ostream& ost)
+{
+  auto& e = exporter();
+  std::lock_guard<std::mutex> lock(e.mutex);
+  Values now;
+  for (const auto& p : Counter_base::stats()) {
+    now[{"tell_counter", "counter=" + quote(p.first)}] += p.second;
+  }
+  for (const auto& s : e.sources) {
+    s.second(now);
+  }
+  Ios_saver guard(ost);
+  ost << std::setprecision(17);
+  const std::string* family = nullptr;
+  for (const auto& p : now) {
+    if (!family || *family != p.first.first) {
+      family = &p.first.first;
+      ost << "# TYPE " << *family << " gauge\n";
+    }
+    // a total that went down has started over
+    const auto i = e.last.find(p.first);
+    const double d = current(p.first.first) || i == e.last.end()
+      || p.second < i->second ? p.second : p.second - i->second;
+    ost << *family << '{' << p.first.second << "} " << d << '\n';
+  }
+  e.last = std::move(now);
+  return ost << "# EOF\n";
+}
+
+inline void tell::Metrics_export::write_file(const std::string& path)
+{
+  const auto tmp = path + ".tmp";
+  {
+    std::ofstream out(tmp);
+    write(out);
+    if (!out) {
+      return;
+    }
+  }
+  std::rename(tmp.c_str(), path.c_str());
+}
+
+inline void tell::Metrics_export::run()
+{
+  auto& e = exporter();
+  std::unique_lock<std::mutex> lock(e.mutex);
+  for (bool last = false; !last; ) {
+    last = e.wake.wait_for(lock, e.interval, [&e] { return !e.running; });
+    const auto path = e.path;
+    lock.unlock();
+    write_file(path);
+    lock.lock();
+  }
+}
+
+inline void tell::Metrics_export::start(const std::string& path,
+					std::chrono::milliseconds interval)
+{
+  stop();
+  auto& e = exporter();
+  {
+    std::lock_guard<std::mutex> lock(e.mutex);
+    e.path = path;
+    e.interval = interval;
+    e.running = true;
+  }
+  e.thread = std::thread(run);
+}
+
+inline void tell::Metrics_export::stop()
+{
+  exporter().halt();
+}
@@ -0,0 +1,183 @@
+#pragma once
+
+#include <tell/util.h>
+
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <string>
+
+//
+// lock contention profiling: time waiting for and holding named locks
+//
+
+namespace tell
+{
+  // one acquisition of a lock, times in nanoseconds
+  struct Lock_sample
+  {
+    double wait;
+    double hold;
+    bool contended;
+  };
+
+  // acquisitions of a lock, how many had to wait, and the statistics of
+  // wait and hold times in Acc (see Timer)
+  template<typename Acc>
+    struct Lock_stats
+    {
+      Lock_stats& operator<<(const Lock_sample& x);
+      Lock_stats& operator+=(const Lock_stats& s);
+      std::size_t acquisitions = 0;
+      std::size_t contended = 0;
+      Acc wait;
+      Acc hold;
+    };
+
+  // drop-in for Mutex (std::lock_guard, std::unique_lock) that records
+  // per label how long lock() waited, whether it found the lock taken,
+  // and how long the lock was held; the owning thread keeps the times in
+  // the wrapper and hands them to per-thread statistics on unlock()
+  template<typename Mutex = std::mutex,
+    typename Acc = Both<Avg, Latency_histo>,
+    typename Clock = std::chrono::high_resolution_clock>
+    class Profiled_mutex
+    {
+      using Stats = impl::Sharded<Profiled_mutex, Lock_stats<Acc>>;
+    public:
+      explicit Profiled_mutex(const char* label = "mutex");
+      template<char... C> explicit Profiled_mutex(ct_string<C...> label);
+      Profiled_mutex(const Profiled_mutex&) = delete;
+      Profiled_mutex& operator=(const Profiled_mutex&) = delete;
+      void lock();
+      bool try_lock();
+      void unlock();
+      static std::map<std::string, Lock_stats<Acc>> stats();
+      static std::ostream& print_stats(std::ostream&);
+    private:
+      Mutex mutex;
+      const char* const label;
+      const std::size_t slot = impl::Labels::none;
+      // written by the owner only, while it holds mutex
+      typename Clock::time_point acquired;
+      typename Clock::duration wait{};
+      bool contended = false;
+      bool on = false;// recording this acquisition, see Switch
+    };
+}
+
+template<typename Acc>
+tell::Lock_stats<Acc>& tell::Lock_stats<Acc>::operator<<(const Lock_sample& x)
+{
+  ++acquisitions;
+  contended += x.contended;
+  wait << x.wait;
+  hold << x.hold;
+  return *this;
+}
+
+template<typename Acc>
+tell::Lock_stats<Acc>& tell::Lock_stats<Acc>::operator+=(const Lock_stats& s)
+{
+  acquisitions += s.acquisitions;
+  contended += s.contended;
+  wait += s.wait;
+  hold += s.hold;
+  return *this;
+}
+
+template<typename Mutex, typename Acc, typename Clock>
+tell::Profiled_mutex<Mutex,Acc,Clock>::Profiled_mutex(const char* label)
+: label(label)
+{
+}
+
+template<typename Mutex, typename Acc, typename Clock>
+template<char... C>
+tell::Profiled_mutex<Mutex,Acc,Clock>::Profiled_mutex(ct_string<C...> label)
+: label(label.c_str())
+, slot(impl::label_slot<ct_string<C...>>())
+{
+}
+
+template<typename Mutex, typename Acc, typename Clock>
+void tell::Profiled_mutex<Mutex,Acc,Clock>::lock()
+{
+  if (!impl::active(label)) {
+    mutex.lock();
+    on = false;
+    return;
+  }
+  // the uncontended path reads the clock once
+  if (mutex.try_lock()) {
+    on = true;
+    acquired = Clock::now();
+    wait = Clock::duration::zero();
+    contended = false;
+    return;
+  }
+  const auto t = Clock::now();
+  mutex.lock();
+  on = true;
+  acquired = Clock::now();
+  wait = acquired - t;
+  contended = true;
+}
+
+template<typename Mutex, typename Acc, typename Clock>
+bool tell::Profiled_mutex<Mutex,Acc,Clock>::try_lock()
+{
+  if (!mutex.try_lock()) {
+    return false;
+  }
+  on = impl::active(label);
+  acquired = Clock::now();
+  wait = Clock::duration::zero();
+  contended = false;
+  return true;
+}
+
+template<typename Mutex, typename Acc, typename Clock>
+void tell::Profiled_mutex<Mutex,Acc,Clock>::unlock()
+{
+  if (!on) {
+    mutex.unlock();
+    return;
+  }
+  using ns = std::chrono::duration<double, std::nano>;
+  const Lock_sample x{
+    ns(wait).count(), ns(Clock::now() - acquired).count(), contended
+  };
+  mutex.unlock();
+  if (slot == impl::Labels::none) {
+    Stats::add(label, x);
+  }
+  else {
+    Stats::add(slot, x);
+  }
+}
+
+template<typename Mutex, typename Acc, typename Clock>
+std::map<std::string, tell::Lock_stats<Acc>>
+tell::Profiled_mutex<Mutex,Acc,Clock>::stats()
+{
+  return Stats::merge();
+}
+
+template<typename Mutex, typename Acc, typename Clock>
+std::ostream& tell::Profiled_mutex<Mutex,Acc,Clock>::print_stats(std::ostream& ost)
+{
+  for (const auto& p : stats()) {
+    const auto& s = p.second;
+    ost
+      << "lock for " << std::right << std::setw(12) << p.first << ": "
+      << std::setw(10) << s.acquisitions << " acquired "
+      << std::setw(10) << s.contended << " contended\n"
+      << std::setw(24) << "wait";
+    impl::print_stat(ost, s.wait, "ns") << '\n' << std::setw(24) << "hold";
+    impl::print_stat(ost, s.hold, "ns") << '\n';
+  }
+  return ost;
+}
@@ -0,0 +1,191 @@
+#pragma once
+
+#include <tell/util.h>
+
+#include <cstdint>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+//
+// hardware performance counters for Timer scopes (Linux perf_event_open)
+//
+
+namespace tell
+{
+  // counter values of the calling thread, or their increase over a scope
+  struct Perf_sample
+  {
+    std::uint64_t cycles = 0;
+    std::uint64_t instructions = 0;
+    std::uint64_t cache_misses = 0;
+    std::uint64_t branch_misses = 0;
+  };
+
+  // per call statistics of the counters
+  struct Perf_stats
+  {
+    Perf_stats& operator<<(const Perf_sample& x);
+    Perf_stats& operator+=(const Perf_stats& s);
+    double ipc() const;
+    Avg cycles;
+    Avg instructions;
+    Avg cache_misses;
+    Avg branch_misses;
+  };
+
+  // Timer probe reading cycles, instructions, cache and branch misses as
+  // one counter group of the thread at scope entry and exit, e.g.
+  // Timer<std::chrono::microseconds, Avg, Tsc_clock, Perf_counters>;
+  // where perf events are denied (containers, perf_event_paranoid) the
+  // probe measures nothing and the Timer reports time only
+  class Perf_counters
+  {
+  public:
+    using Sample = Perf_sample;
+    using Acc = Perf_stats;
+    Perf_counters();
+    bool stop(Sample& x);
+    static bool available();
+    static std::ostream& print(std::ostream&, const Acc&);
+  private:
+    // counter group opened once per thread
+    class Group
+    {
+    public:
+      Group();
+      ~Group();
+      bool read(Sample& x) const;
+      bool ok() const;
+    private:
+      static constexpr int n = 4;
+      int fd[n] = {-1, -1, -1, -1};
+    };
+    static const Group& group();
+    Sample start;
+    bool valid;
+  };
+}
+
+inline tell::Perf_stats& tell::Perf_stats::operator<<(const Perf_sample& x)
+{
+  cycles << x.cycles;
+  instructions << x.instructions;
+  cache_misses << x.cache_misses;
+  branch_misses << x.branch_misses;
+  return *this;
+}
+
+inline tell::Perf_stats& tell::Perf_stats::operator+=(const Perf_stats& s)
+{
+  cycles += s.cycles;
+  instructions += s.instructions;
+  cache_misses += s.cache_misses;
+  branch_misses += s.branch_misses;
+  return *this;
+}
+
+inline double tell::Perf_stats::ipc() const
+{
+  const double c = cycles().first;
+  return c == 0 ? 0.0 : instructions().first/c;
+}
+
+inline tell::Perf_counters::Group::Group()
+{
+  const std::uint64_t config[n] = {
+    PERF_COUNT_HW_CPU_CYCLES,
+    PERF_COUNT_HW_INSTRUCTIONS,
+    PERF_COUNT_HW_CACHE_MISSES,
+    PERF_COUNT_HW_BRANCH_MISSES
+  };
+  for (int i = 0; i != n; ++i) {
+    perf_event_attr a;
+    std::memset(&a, 0, sizeof(a));
+    a.size = sizeof(a);
+    a.type = PERF_TYPE_HARDWARE;
+    a.config = config[i];
+    a.read_format = PERF_FORMAT_GROUP;
+    a.exclude_kernel = 1;
+    a.exclude_hv = 1;
+    fd[i] = syscall(SYS_perf_event_open, &a, 0, -1, i == 0 ? -1 : fd[0], 0);
+    if (fd[i] < 0) {
+      // all or nothing: fall back to time only
+      for (int j = 0; j != i; ++j) {
+	close(fd[j]);
+	fd[j] = -1;
+      }
+      return;
+    }
+  }
+}
+
+inline tell::Perf_counters::Group::~Group()
+{
+  for (int i = n; i-- != 0; ) {
+    if (0 <= fd[i]) {
+      close(fd[i]);
+    }
+  }
+}
+
+inline bool tell::Perf_counters::Group::ok() const
+{
+  return 0 <= fd[0];
+}
+
+inline bool tell::Perf_counters::Group::read(Sample& x) const
+{
+  std::uint64_t buf[1+n];
+  if (!ok() || ::read(fd[0], buf, sizeof(buf)) != sizeof(buf)) {
+    return false;
+  }
+  x = {buf[1], buf[2], buf[3], buf[4]};
+  return true;
+}
+
+inline const tell::Perf_counters::Group& tell::Perf_counters::group()
+{
+  thread_local const Group g;
+  return g;
+}
+
+inline bool tell::Perf_counters::available()
+{
+  return group().ok();
+}
+
+inline tell::Perf_counters::Perf_counters()
+: valid(group().read(start))
+{
+}
+
+inline bool tell::Perf_counters::stop(Sample& x)
+{
+  Sample end;
+  if (!valid || !group().read(end)) {
+    return false;
+  }
+  x = {
+    end.cycles - start.cycles,
+    end.instructions - start.instructions,
+    end.cache_misses - start.cache_misses,
+    end.branch_misses - start.branch_misses
+  };
+  return true;
+}
+
+inline std::ostream&
+tell::Perf_counters::print(std::ostream& ost, const Acc& s)
+{
+  Ios_saver guard(ost);
+  return ost
+    << " IPC" << std::right << std::setw(6) << std::setprecision(3)
+    << s.ipc()
+    << " cache-misses/call" << std::setw(10) << s.cache_misses().first
+    << " branch-misses/call" << std::setw(10) << s.branch_misses().first;
+}
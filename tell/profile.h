@@ -0,0 +1,249 @@
+#pragma once
+
+#include <tell/util.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <deque>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+
+//
+// hierarchical profiling: nested scopes are attributed to their call path
+//
+
+namespace tell
+{
+  // calls, inclusive and exclusive time of a call path
+  struct Path_stats
+  {
+    std::size_t calls = 0;
+    double inclusive = 0;
+    double exclusive = 0;
+  };
+
+  // scope timer that keeps a per-thread stack of open scopes, so that a
+  // Profile("parse") inside a Profile("request") is reported as
+  // request;parse, with the time of child scopes excluded from the parent
+  template<typename P = std::chrono::microseconds,
+    typename Clock = std::chrono::high_resolution_clock>
+    class Profile
+    {
+      using Rep = typename Clock::rep;
+    public:
+      using Path = std::vector<std::string>;
+      Profile(const char* label = "run");
+      ~Profile();
+      Profile(const Profile&) = delete;
+      Profile& operator=(const Profile&) = delete;
+      // statistics per call path, in units of P, merged over threads
+      static std::map<Path, Path_stats> stats();
+      // indented call tree: calls, inclusive and exclusive time
+      static std::ostream& print_stats(std::ostream&);
+      // one line "a;b;c exclusive-time" per path, as read by flamegraph.pl
+      static std::ostream& print_collapsed(std::ostream&);
+    private:
+      // node of the per-thread call tree; the owning thread is the only
+      // writer, relaxed atomics let reporters read while it runs
+      struct Node
+      {
+	Node(const char* label, std::size_t parent);
+	const char* label;
+	std::size_t parent;
+	std::vector<std::size_t> children;// owner only
+	std::atomic<std::size_t> calls{0};
+	std::atomic<Rep> inclusive{0};
+	std::atomic<Rep> exclusive{0};
+      };
+      struct Frame
+      {
+	std::size_t node;
+	typename Clock::time_point start;
+	Rep child;// time spent in child scopes
+      };
+      struct alignas(impl::cache_line) Shard
+      {
+	Shard();
+	~Shard();
+	std::size_t enter(const char* label);
+	Path path(std::size_t node) const;
+	std::deque<Node> nodes;// nodes[0] is the root
+	std::vector<Frame> stack;
+      };
+      struct Registry
+      {
+	std::mutex mutex;
+	std::vector<Shard*> live;
+	std::map<Path, Path_stats> retired;
+      };
+      static Registry& registry();
+      static Shard& local();
+      static void add(std::map<Path, Path_stats>& m, const Shard& s);
+      const bool on;
+    };
+}
+
+template<typename P, typename Clock>
+tell::Profile<P,Clock>::Node::Node(const char* label, std::size_t parent)
+: label(label)
+, parent(parent)
+{
+}
+
+template<typename P, typename Clock>
+tell::Profile<P,Clock>::Shard::Shard()
+{
+  nodes.emplace_back(nullptr, 0);
+  stack.push_back({0, Clock::now(), 0});
+  auto& r = registry();
+  std::lock_guard<std::mutex> lock(r.mutex);
+  r.live.push_back(this);
+}
+
+template<typename P, typename Clock>
+tell::Profile<P,Clock>::Shard::~Shard()
+{
+  auto& r = registry();
+  std::lock_guard<std::mutex> lock(r.mutex);
+  add(r.retired, *this);
+  r.live.erase(std::find(r.live.begin(), r.live.end(), this));
+}
+
+template<typename P, typename Clock>
+std::size_t tell::Profile<P,Clock>::Shard::enter(const char* label)
+{
+  const auto parent = stack.back().node;
+  for (const auto c : nodes[parent].children) {
+    if (nodes[c].label == label) {
+      return c;
+    }
+  }
+  std::lock_guard<std::mutex> lock(registry().mutex);
+  nodes.emplace_back(label, parent);
+  nodes[parent].children.push_back(nodes.size() - 1);
+  return nodes.size() - 1;
+}
+
+template<typename P, typename Clock>
+typename tell::Profile<P,Clock>::Path
+tell::Profile<P,Clock>::Shard::path(std::size_t node) const
+{
+  Path p;
+  for (; node != 0; node = nodes[node].parent) {
+    p.push_back(nodes[node].label);
+  }
+  std::reverse(p.begin(), p.end());
+  return p;
+}
+
+template<typename P, typename Clock>
+typename tell::Profile<P,Clock>::Registry& tell::Profile<P,Clock>::registry()
+{
+  static Registry r;
+  return r;
+}
+
+template<typename P, typename Clock>
+typename tell::Profile<P,Clock>::Shard& tell::Profile<P,Clock>::local()
+{
+  thread_local Shard s;
+  return s;
+}
+
+template<typename P, typename Clock>
+void tell::Profile<P,Clock>::add(std::map<Path, Path_stats>& m, const Shard& s)
+{
+  using D = typename Clock::duration;
+  const auto in_p = [](Rep r) {
+    return std::chrono::duration_cast<std::chrono::duration<double,
+      typename P::period>>(D(r)).count();
+  };
+  for (std::size_t i = 1; i != s.nodes.size(); ++i) {
+    const auto& n = s.nodes[i];
+    auto& t = m[s.path(i)];
+    t.calls += n.calls.load(std::memory_order_relaxed);
+    t.inclusive += in_p(n.inclusive.load(std::memory_order_relaxed));
+    t.exclusive += in_p(n.exclusive.load(std::memory_order_relaxed));
+  }
+}
+
+template<typename P, typename Clock>
+tell::Profile<P,Clock>::Profile(const char* label)
+: on(impl::active(label))
+{
+  // a scope switched off is part of its parent
+  if (!on) {
+    return;
+  }
+  auto& s = local();
+  const auto n = s.enter(label);
+  s.stack.push_back({n, Clock::now(), 0});
+}
+
+template<typename P, typename Clock>
+tell::Profile<P,Clock>::~Profile()
+{
+  if (!on) {
+    return;
+  }
+  auto& s = local();
+  const auto f = s.stack.back();
+  s.stack.pop_back();
+  const auto d = std::max(Clock::now() - f.start - clock_overhead<Clock>,
+			  Clock::duration::zero()).count();
+  auto& n = s.nodes[f.node];
+  const auto relaxed = std::memory_order_relaxed;
+  n.calls.store(n.calls.load(relaxed) + 1, relaxed);
+  n.inclusive.store(n.inclusive.load(relaxed) + d, relaxed);
+  n.exclusive.store(n.exclusive.load(relaxed) + d - f.child, relaxed);
+  s.stack.back().child += d;
+}
+
+template<typename P, typename Clock>
+std::map<typename tell::Profile<P,Clock>::Path, tell::Path_stats>
+tell::Profile<P,Clock>::stats()
+{
+  auto& r = registry();
+  std::lock_guard<std::mutex> lock(r.mutex);
+  auto m = r.retired;
+  for (const auto s : r.live) {
+    add(m, *s);
+  }
+  return m;
+}
+
+template<typename P, typename Clock>
+std::ostream& tell::Profile<P,Clock>::print_stats(std::ostream& ost)
+{
+  for (const auto& p : stats()) {
+    const auto indent = 2*(p.first.size() - 1);
+    ost
+      << "profile for " << std::string(indent, ' ') << std::left
+      << std::setw(std::max<int>(1, 24 - indent)) << p.first.back()
+      << std::right << std::setw(10) << p.second.calls << " calls"
+      << std::setw(15) << p.second.inclusive << precision<P> << " incl"
+      << std::setw(15) << p.second.exclusive << precision<P> << " excl"
+      << '\n';
+  }
+  return ost;
+}
+
+template<typename P, typename Clock>
+std::ostream& tell::Profile<P,Clock>::print_collapsed(std::ostream& ost)
+{
+  for (const auto& p : stats()) {
+    const char* sep = "";
+    for (const auto& l : p.first) {
+      ost << sep << l;
+      sep = ";";
+    }
+    ost << ' ' << static_cast<long long>(std::llround(p.second.exclusive))
+	<< '\n';
+  }
+  return ost;
+}
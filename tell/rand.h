@@ -403,7 +403,9 @@ E& tell::rand::Base<E>::engine()
 template<typename E>
 auto tell::Tracking_engine<E>::operator()()
 {
-  ++calls_;
+  if (impl::active()) {
+    ++calls_;
+  }
   return E::operator()();
 }
 
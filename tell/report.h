@@ -0,0 +1,225 @@
+#pragma once
+
+#include <tell/util.h>
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <iomanip>
+#include <iostream>
+#include <mutex>
+#include <sstream>
+#include <thread>
+
+//
+// asynchronous Stop_watch reporting: the timed thread only enqueues
+//
+
+namespace tell
+{
+  // while started, Stop_watch destructors push fixed-size records into a
+  // lock-free bounded multi-producer queue instead of writing to
+  // std::cout; a background thread drains it, formats a batch at a time
+  // and writes it with a single flush; records arriving while the queue
+  // is full are dropped and counted rather than blocking the producer,
+  // and so are those of producers that took the sink just before stop()
+  // and arrive after it
+  class Async_report
+  {
+  public:
+    static constexpr std::size_t capacity = 4096;
+    static void start(std::ostream& ost = std::cout,
+		      std::chrono::milliseconds interval
+		      = std::chrono::milliseconds(50));
+    // drain what is queued and stop the writer thread
+    static void stop();
+    static std::size_t dropped();
+  private:
+    struct Record
+    {
+      const char* label;
+      long long count;
+      const char* unit;
+    };
+    // bounded queue after D. Vyukov: a cell's sequence number tells
+    // producers and the consumer whose turn it is
+    struct Cell
+    {
+      std::atomic<std::size_t> seq;
+      Record r;
+    };
+    class Queue
+    {
+    public:
+      Queue();
+      bool push(const Record& r);
+      bool pop(Record& r);// single consumer
+    private:
+      std::array<Cell, capacity> cells;
+      alignas(impl::cache_line) std::atomic<std::size_t> tail{0};
+      alignas(impl::cache_line) std::size_t head = 0;
+    };
+    struct Writer
+    {
+      ~Writer();
+      void halt();
+      Queue queue;
+      std::atomic<std::size_t> dropped{0};
+      // producers in sink(), and whether it still takes records
+      std::atomic<std::size_t> busy{0};
+      std::atomic<bool> open{false};
+      std::mutex mutex;
+      std::condition_variable wake;
+      bool running = false;
+      std::ostream* ost = nullptr;
+      std::chrono::milliseconds interval{0};
+      std::thread thread;
+    };
+    static Writer& writer();
+    static void sink(const char* label, long long count, const char* unit);
+    static void drain(Writer& w);
+    static void run();
+  };
+}
+
+inline tell::Async_report::Queue::Queue()
+{
+  for (std::size_t i = 0; i != capacity; ++i) {
+    cells[i].seq.store(i, std::memory_order_relaxed);
+  }
+}
+
+inline bool tell::Async_report::Queue::push(const Record& r)
+{
+  auto pos = tail.load(std::memory_order_relaxed);
+  for (;;) {
+    auto& c = cells[pos % capacity];
+    const auto seq = c.seq.load(std::memory_order_acquire);
+    const auto diff = static_cast<std::intptr_t>(seq - pos);
+    if (diff == 0) {
+      if (tail.compare_exchange_weak(pos, pos+1, std::memory_order_relaxed)) {
+	c.r = r;
+	c.seq.store(pos+1, std::memory_order_release);
+	return true;
+      }
+    }
+    else if (diff < 0) {
+      return false;// full
+    }
+    else {
+      pos = tail.load(std::memory_order_relaxed);
+    }
+  }
+}
+
+inline bool tell::Async_report::Queue::pop(Record& r)
+{
+  auto& c = cells[head % capacity];
+  const auto seq = c.seq.load(std::memory_order_acquire);
+  if (static_cast<std::intptr_t>(seq - (head+1)) < 0) {
+    return false;// empty
+  }
+  r = c.r;
+  c.seq.store(head + capacity, std::memory_order_release);
+  ++head;
+  return true;
+}
+
+inline tell::Async_report::Writer::~Writer()
+{
+  halt();
+}
+
+inline void tell::Async_report::Writer::halt()
+{
+  impl::report_sink.store(nullptr, std::memory_order_release);
+  open.store(false);
+  if (!thread.joinable()) {
+    return;
+  }
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    running = false;
+  }
+  wake.notify_one();
+  thread.join();
+  // producers that saw the sink open may push after the last drain
+  while (busy.load() != 0) {
+    std::this_thread::yield();
+  }
+  drain(*this);
+}
+
+inline tell::Async_report::Writer& tell::Async_report::writer()
+{
+  static Writer w;
+  return w;
+}
+
+inline void
+tell::Async_report::sink(const char* label, long long count, const char* unit)
+{
+  auto& w = writer();
+  // sequentially consistent with halt(): either it waits for us or we
+  // see it closed
+  w.busy.fetch_add(1);
+  if (!w.open.load() || !w.queue.push({label, count, unit})) {
+    w.dropped.fetch_add(1, std::memory_order_relaxed);
+  }
+  w.busy.fetch_sub(1, std::memory_order_release);
+}
+
+inline void tell::Async_report::drain(Writer& w)
+{
+  std::ostringstream batch;
+  Record r;
+  while (w.queue.pop(r)) {
+    batch
+      << "timing for " << std::right << std::setw(12) << r.label << ": "
+      << std::right << std::setw(20) << r.count << r.unit << '\n';
+  }
+  const auto s = batch.str();
+  if (!s.empty()) {
+    w.ost->write(s.data(), s.size());
+    w.ost->flush();
+  }
+}
+
+inline void tell::Async_report::run()
+{
+  auto& w = writer();
+  std::unique_lock<std::mutex> lock(w.mutex);
+  while (w.running) {
+    w.wake.wait_for(lock, w.interval);
+    drain(w);
+  }
+  drain(w);
+}
+
+inline void
+tell::Async_report::start(std::ostream& ost, std::chrono::milliseconds interval)
+{
+  stop();
+  auto& w = writer();
+  {
+    std::lock_guard<std::mutex> lock(w.mutex);
+    w.ost = &ost;
+    w.interval = interval;
+    w.running = true;
+  }
+  w.thread = std::thread(run);
+  w.open.store(true);
+  impl::report_sink.store(&sink, std::memory_order_release);
+}
+
+inline void tell::Async_report::stop()
+{
+  writer().halt();
+}
+
+inline std::size_t tell::Async_report::dropped()
+{
+  return writer().dropped.load(std::memory_order_relaxed);
+}
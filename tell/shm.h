@@ -0,0 +1,517 @@
+#pragma once
+
+#include <tell/util.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cmath>
+#include <condition_variable>
+#include <cstring>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <tuple>
+#include <vector>
+
+#include <fcntl.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+//
+// shared-memory segment of Timer, Counter and Histo statistics, read
+// and aggregated across worker processes
+//
+
+namespace tell
+{
+  // count, mean, spread and range of the samples of a statistic
+  struct Shm_stats
+  {
+    Shm_stats& operator+=(const Shm_stats& s);
+    std::pair<double,double> operator()() const;
+    double count = 0;
+    double mean = 0;
+    double m2 = 0;// sum of squared deviations
+    double min = HUGE_VAL;
+    double max = -HUGE_VAL;
+  };
+
+  // each worker process attaches to a POSIX shared memory segment with
+  // its number and publishes its statistics into its own region of it,
+  // at an interval or on demand; a supervisor reads all regions live;
+  // a worker attaching again with the same number, e.g. after a
+  // restart, takes over what its region holds and publishes its new
+  // statistics on top of it, while the process that held the number
+  // still runs the number is refused; regions are written at publish
+  // only, what a worker that crashed measured since is lost; the
+  // segment starts with a header, a segment of another version or
+  // layout (e.g. max_entries) is refused by workers and supervisor
+  class Shm_metrics
+  {
+  public:
+    static constexpr std::size_t max_workers = 64;
+    static constexpr std::size_t max_entries = 256;
+    enum class Kind : char { timer = 't', counter = 'c', histo = 'h' };
+    // statistic of a worker: kind, name given to add() (the counter
+    // name for counters) and label (the histogram value for histos)
+    using Key = std::tuple<Kind, std::string, std::string>;
+
+    // map segment name (e.g. "/myservice") as worker; false on failure
+    static bool attach(const std::string& name, std::size_t worker);
+    // unmap and forget the sources
+    static void detach();
+    // publish a timer type, e.g. add<Timer<>>("request"), in its units
+    template<typename T>
+      static void add(const char* name);
+    // publish a histogram, read under the lock that guards its updates
+    template<typename H>
+      static void add(const char* name, const H& h, std::mutex& m);
+    static void publish();
+    static void start(std::chrono::milliseconds interval
+		      = std::chrono::seconds(1));
+    static void stop();
+
+    // supervisor side: the statistics of every worker, and merged
+    static std::map<std::size_t, std::map<Key, Shm_stats>>
+    workers(const std::string& name);
+    static std::map<Key, Shm_stats> aggregate(const std::string& name);
+    static std::ostream& print(std::ostream&, const std::string& name);
+  private:
+    struct Entry
+    {
+      Kind kind;
+      char name[23];
+      char label[48];
+      Shm_stats stats;
+    };
+    // written by its worker only, under a seqlock for readers; pid is
+    // the worker process attached, 0 for none
+    struct Region
+    {
+      std::atomic<std::uint64_t> seq;
+      std::atomic<std::uint64_t> pid;
+      std::uint64_t n;
+      Entry entries[max_entries];
+    };
+    // set by the first worker to attach, magic last
+    struct Header
+    {
+      std::atomic<std::uint64_t> magic;
+      std::atomic<std::uint64_t> version;
+      std::atomic<std::uint64_t> size;
+    };
+    struct Segment
+    {
+      Header header;
+      Region regions[max_workers];
+    };
+    static constexpr std::uint64_t magic = 0x6d68735f6c6c6574;// "tell_shm"
+    static constexpr std::uint64_t version = 1;
+    static_assert(std::atomic<std::uint64_t>::is_always_lock_free);
+    using Values = std::map<Key, Shm_stats>;
+    using Source = std::function<void(Values&)>;
+    struct Worker
+    {
+      ~Worker();
+      void halt();
+      std::mutex mutex;
+      Segment* segment = nullptr;
+      Region* region = nullptr;
+      Values base;// region contents found when attaching
+      std::vector<Source> sources;
+      std::condition_variable wake;
+      bool running = false;
+      std::chrono::milliseconds interval{0};
+      std::thread thread;
+    };
+    static Worker& worker();
+    // nullptr on failure or for a segment of another layout
+    static Segment* map(const std::string& name, bool write);
+    static bool alive(std::uint64_t pid);
+    // false if r stays torn, e.g. its worker died while publishing
+    static bool read(const Region& r, Values& v);
+    static Shm_stats summary(const Avg& a);
+    static Shm_stats summary(const Latency_histo& h);
+    // the samples in the window as of now
+    template<std::size_t slots, std::int64_t width_ms>
+      static Shm_stats summary(const Window_avg<slots,width_ms>& w);
+    // count is the decayed weight, min and max are unknown
+    template<std::int64_t half_life_ms>
+      static Shm_stats summary(const Decayed_avg<half_life_ms>& d);
+    template<typename A, typename B>
+      static Shm_stats summary(const Both<A,B>& b);
+    static void run();
+  };
+}
+
+inline tell::Shm_stats& tell::Shm_stats::operator+=(const Shm_stats& s)
+{
+  if (s.count == 0) {
+    return *this;
+  }
+  // Chan et al., as for Avg
+  const double na = count;
+  const double d = s.mean - mean;
+  count += s.count;
+  mean += d*s.count/count;
+  m2 += s.m2 + d*d*na*s.count/count;
+  min = std::min(min, s.min);
+  max = std::max(max, s.max);
+  return *this;
+}
+
+inline std::pair<double,double> tell::Shm_stats::operator()() const
+{
+  return {mean, count == 0 ? 0.0 : std::sqrt(m2/count)};
+}
+
+template<typename T>
+void tell::Shm_metrics::add(const char* name)
+{
+  auto& w = worker();
+  std::lock_guard<std::mutex> lock(w.mutex);
+  w.sources.push_back([name](Values& v) {
+      for (const auto& p : T::stats()) {
+	v[{Kind::timer, name, p.first}] += summary(p.second);
+      }
+    });
+}
+
+template<typename H>
+void tell::Shm_metrics::add(const char* name, const H& h, std::mutex& m)
+{
+  auto& w = worker();
+  std::lock_guard<std::mutex> lock(w.mutex);
+  w.sources.push_back([name, &h, &m](Values& v) {
+      std::lock_guard<std::mutex> lock(m);
+      for (const auto& b : h.bins()) {
+	std::ostringstream value;
+	value << b.first;
+	Shm_stats s;
+	s.count = b.second;
+	v[{Kind::histo, name, value.str()}] += s;
+      }
+    });
+}
+
+inline tell::Shm_stats tell::Shm_metrics::summary(const Avg& a)
+{
+  Shm_stats s;
+  double sigma;
+  std::tie(s.mean, sigma) = a();
+  s.count = a.count();
+  s.m2 = sigma*sigma*s.count;
+  s.min = a.min();
+  s.max = a.max();
+  return s;
+}
+
+inline tell::Shm_stats tell::Shm_metrics::summary(const Latency_histo& h)
+{
+  Shm_stats s;
+  s.count = h.count();
+  s.mean = h.mean();
+  s.max = h.max();
+  return s;
+}
+
+template<std::size_t slots, std::int64_t width_ms>
+tell::Shm_stats
+tell::Shm_metrics::summary(const Window_avg<slots,width_ms>& w)
+{
+  return summary(w.window());
+}
+
+template<std::int64_t half_life_ms>
+tell::Shm_stats tell::Shm_metrics::summary(const Decayed_avg<half_life_ms>& d)
+{
+  Shm_stats s;
+  double sigma;
+  std::tie(s.mean, sigma) = d();
+  s.count = d.weight();
+  s.m2 = sigma*sigma*s.count;
+  return s;
+}
+
+template<typename A, typename B>
+tell::Shm_stats tell::Shm_metrics::summary(const Both<A,B>& b)
+{
+  return summary(b.first);
+}
+
+inline tell::Shm_metrics::Worker::~Worker()
+{
+  halt();
+}
+
+inline void tell::Shm_metrics::Worker::halt()
+{
+  if (!thread.joinable()) {
+    return;
+  }
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    running = false;
+  }
+  wake.notify_one();
+  thread.join();
+}
+
+inline tell::Shm_metrics::Worker& tell::Shm_metrics::worker()
+{
+  static Worker w;
+  return w;
+}
+
+inline tell::Shm_metrics::Segment*
+tell::Shm_metrics::map(const std::string& name, bool write)
+{
+  const int fd = shm_open(name.c_str(), write ? O_RDWR | O_CREAT : O_RDONLY,
+			  0600);
+  if (fd < 0) {
+    return nullptr;
+  }
+  // a new segment grows to its size zero filled, i.e. all regions
+  // empty; one of another size is not touched
+  struct stat st;
+  bool ok = fstat(fd, &st) == 0;
+  if (ok && write && st.st_size == 0) {
+    ok = ftruncate(fd, sizeof(Segment)) == 0 && fstat(fd, &st) == 0;
+  }
+  if (!ok || st.st_size != static_cast<off_t>(sizeof(Segment))) {
+    close(fd);
+    return nullptr;
+  }
+  void* p = mmap(nullptr, sizeof(Segment),
+		 write ? PROT_READ | PROT_WRITE : PROT_READ, MAP_SHARED, fd, 0);
+  close(fd);
+  if (p == MAP_FAILED) {
+    return nullptr;
+  }
+  auto s = static_cast<Segment*>(p);
+  auto& h = s->header;
+  if (write && h.magic.load(std::memory_order_acquire) == 0) {
+    // workers attaching at once store the same values
+    h.version.store(version, std::memory_order_relaxed);
+    h.size.store(sizeof(Segment), std::memory_order_relaxed);
+    std::uint64_t none = 0;
+    h.magic.compare_exchange_strong(none, magic, std::memory_order_release);
+  }
+  if (h.magic.load(std::memory_order_acquire) != magic ||
+      h.version.load(std::memory_order_relaxed) != version ||
+      h.size.load(std::memory_order_relaxed) != sizeof(Segment)) {
+    munmap(p, sizeof(Segment));
+    return nullptr;
+  }
+  return s;
+}
+
+inline bool tell::Shm_metrics::alive(std::uint64_t pid)
+{
+  return kill(static_cast<pid_t>(pid), 0) == 0 || errno == EPERM;
+}
+
+inline bool tell::Shm_metrics::read(const Region& r, Values& v)
+{
+  for (int tries = 0; tries != 1000; ++tries) {
+    const auto s0 = r.seq.load(std::memory_order_acquire);
+    if (s0 & 1) {
+      std::this_thread::yield();
+      continue;
+    }
+    v.clear();
+    const auto n = std::min<std::uint64_t>(r.n, max_entries);
+    for (std::uint64_t i = 0; i != n; ++i) {
+      const auto& e = r.entries[i];
+      v[{e.kind, std::string(e.name, strnlen(e.name, sizeof(e.name))),
+	 std::string(e.label, strnlen(e.label, sizeof(e.label)))}] += e.stats;
+    }
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if (r.seq.load(std::memory_order_relaxed) == s0) {
+      return true;
+    }
+  }
+  return false;
+}
+
+inline bool tell::Shm_metrics::attach(const std::string& name,
+				      std::size_t worker_no)
+{
+  detach();
+  if (max_workers <= worker_no) {
+    return false;
+  }
+  const auto s = map(name, true);
+  if (!s) {
+    return false;
+  }
+  // a previous owner that still runs keeps the region
+  auto& r = s->regions[worker_no];
+  const std::uint64_t self = getpid();
+  auto pid = r.pid.load(std::memory_order_relaxed);
+  if ((pid != 0 && pid != self && alive(pid)) ||
+      !r.pid.compare_exchange_strong(pid, self, std::memory_order_acquire)) {
+    munmap(s, sizeof(Segment));
+    return false;
+  }
+  auto& w = worker();
+  std::lock_guard<std::mutex> lock(w.mutex);
+  w.segment = s;
+  w.region = &r;
+  // a previous owner may have died while publishing: its data is
+  // taken over as it is
+  const auto seq = r.seq.load(std::memory_order_relaxed);
+  r.seq.store(seq + (seq & 1), std::memory_order_relaxed);
+  read(r, w.base);
+  return true;
+}
+
+inline void tell::Shm_metrics::detach()
+{
+  stop();
+  auto& w = worker();
+  std::lock_guard<std::mutex> lock(w.mutex);
+  if (w.segment) {
+    // a forked child leaves its parent's region to the parent
+    std::uint64_t self = getpid();
+    w.region->pid.compare_exchange_strong(self, 0, std::memory_order_release);
+    munmap(w.segment, sizeof(Segment));
+  }
+  w.segment = nullptr;
+  w.region = nullptr;
+  w.base.clear();
+  w.sources.clear();
+}
+
+inline void tell::Shm_metrics::publish()
+{
+  auto& w = worker();
+  std::lock_guard<std::mutex> lock(w.mutex);
+  if (!w.region) {
+    return;
+  }
+  auto v = w.base;
+  for (const auto& p : Counter_base::stats()) {
+    Shm_stats s;
+    s.count = p.second;
+    v[{Kind::counter, p.first, ""}] += s;
+  }
+  for (const auto& s : w.sources) {
+    s(v);
+  }
+  // longer names and labels are cut, as in base, and merged with the
+  // statistics they then share
+  Values cut;
+  for (const auto& p : v) {
+    cut[{std::get<0>(p.first), std::get<1>(p.first).substr(0, sizeof(Entry::name)),
+	 std::get<2>(p.first).substr(0, sizeof(Entry::label))}] += p.second;
+  }
+  auto& r = *w.region;
+  const auto seq = r.seq.load(std::memory_order_relaxed);
+  r.seq.store(seq + 1, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+  std::uint64_t n = 0;
+  for (const auto& p : cut) {
+    if (n == max_entries) {
+      break;
+    }
+    auto& e = r.entries[n++];
+    e.kind = std::get<0>(p.first);
+    std::strncpy(e.name, std::get<1>(p.first).c_str(), sizeof(e.name));
+    std::strncpy(e.label, std::get<2>(p.first).c_str(), sizeof(e.label));
+    e.stats = p.second;
+  }
+  r.n = n;
+  r.seq.store(seq + 2, std::memory_order_release);
+}
+
+inline void tell::Shm_metrics::run()
+{
+  auto& w = worker();
+  std::unique_lock<std::mutex> lock(w.mutex);
+  for (bool last = false; !last; ) {
+    last = w.wake.wait_for(lock, w.interval, [&w] { return !w.running; });
+    lock.unlock();
+    publish();
+    lock.lock();
+  }
+}
+
+inline void tell::Shm_metrics::start(std::chrono::milliseconds interval)
+{
+  stop();
+  auto& w = worker();
+  {
+    std::lock_guard<std::mutex> lock(w.mutex);
+    w.interval = interval;
+    w.running = true;
+  }
+  w.thread = std::thread(run);
+}
+
+inline void tell::Shm_metrics::stop()
+{
+  worker().halt();
+}
+
+inline std::map<std::size_t, std::map<tell::Shm_metrics::Key, tell::Shm_stats>>
+tell::Shm_metrics::workers(const std::string& name)
+{
+  std::map<std::size_t, Values> m;
+  const auto s = map(name, false);
+  if (!s) {
+    return m;
+  }
+  for (std::size_t i = 0; i != max_workers; ++i) {
+    Values v;
+    if (read(s->regions[i], v) && !v.empty()) {
+      m[i] = std::move(v);
+    }
+  }
+  munmap(s, sizeof(Segment));
+  return m;
+}
+
+inline std::map<tell::Shm_metrics::Key, tell::Shm_stats>
+tell::Shm_metrics::aggregate(const std::string& name)
+{
+  Values m;
+  for (const auto& w : workers(name)) {
+    for (const auto& p : w.second) {
+      m[p.first] += p.second;
+    }
+  }
+  return m;
+}
+
+inline std::ostream&
+tell::Shm_metrics::print(std::ostream& ost, const std::string& name)
+{
+  for (const auto& p : aggregate(name)) {
+    const auto& s = p.second;
+    ost
+      << static_cast<char>(std::get<0>(p.first)) << ' '
+      << std::left << std::setw(16) << std::get<1>(p.first)
+      << std::setw(16) << std::get<2>(p.first) << std::right
+      << std::setw(12) << s.count;
+    if (std::get<0>(p.first) == Kind::timer) {
+      double mu, sigma;
+      std::tie(mu, sigma) = s();
+      ost
+	<< std::setw(15) << mu << " +-" << std::setw(8) << sigma
+	<< " min" << std::setw(10) << s.min << " max" << std::setw(10)
+	<< s.max;
+    }
+    ost << '\n';
+  }
+  return ost;
+}
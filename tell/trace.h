@@ -0,0 +1,178 @@
+#pragma once
+
+#include <tell/util.h>
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include <unistd.h>
+
+//
+// Chrome trace-event export of Stop_watch and Timer scopes, readable by
+// chrome://tracing and ui.perfetto.dev
+//
+
+namespace tell
+{
+  // while started, every Stop_watch and Timer scope is recorded as one
+  // complete event (begin and duration) into a ring buffer of the thread;
+  // when a ring is full the oldest events are overwritten, the newest
+  // capacity-1 events can be written out; the ring of a thread that
+  // exited is taken over by the next new thread, every event carries
+  // the tid of the thread that recorded it
+  class Trace
+  {
+  public:
+    static constexpr std::size_t capacity = std::size_t{1} << 16;
+    static void start();
+    static void stop();
+    // trace JSON of the events currently held in all rings
+    static std::ostream& write(std::ostream&);
+    // write trace JSON to a file when the program exits
+    static void write_at_exit(const std::string& path);
+  private:
+    // written by the owning thread only, relaxed atomics let write()
+    // read concurrently; begin and duration in nanoseconds
+    struct Event
+    {
+      std::atomic<const char*> label{nullptr};
+      std::atomic<std::int64_t> begin{0};
+      std::atomic<std::int64_t> dur{0};
+      std::atomic<int> tid{0};
+    };
+    struct alignas(impl::cache_line) Ring
+    {
+      void push(const char* label, std::int64_t begin, std::int64_t dur,
+		int tid);
+      std::atomic<std::uint64_t> head{0};
+      std::array<Event, capacity> events;
+    };
+    // rings outlive their threads so that they can be written at exit
+    using Rings = impl::Recycled<Ring>;
+    struct Registry
+    {
+      std::mutex mutex;
+      std::string exit_path;
+    };
+    static Registry& registry();
+    static void record(const char* label, std::int64_t ns);
+    static void write_exit_file();
+  };
+}
+
+inline void
+tell::Trace::Ring::push(const char* label, std::int64_t begin, std::int64_t dur,
+			int tid)
+{
+  const auto h = head.load(std::memory_order_relaxed);
+  auto& e = events[h % capacity];
+  e.label.store(label, std::memory_order_relaxed);
+  e.begin.store(begin, std::memory_order_relaxed);
+  e.dur.store(dur, std::memory_order_relaxed);
+  e.tid.store(tid, std::memory_order_relaxed);
+  head.store(h+1, std::memory_order_release);
+}
+
+inline tell::Trace::Registry& tell::Trace::registry()
+{
+  static Registry r;
+  return r;
+}
+
+inline void tell::Trace::record(const char* label, std::int64_t ns)
+{
+  const auto end = Tsc_clock::now().time_since_epoch().count();
+  const auto& u = Rings::local();
+  u.object->push(label, end - ns, ns, u.tid);
+}
+
+inline void tell::Trace::start()
+{
+  Tsc_clock::now();// calibrate before the first event
+  impl::scope_hook.store(&record, std::memory_order_relaxed);
+}
+
+inline void tell::Trace::stop()
+{
+  impl::scope_hook.store(nullptr, std::memory_order_relaxed);
+}
+
+inline std::ostream& tell::Trace::write(std::ostream& ost)
+{
+  const auto escape = [&ost](const char* s) {
+    for (; *s; ++s) {
+      if (*s == '"' || *s == '\\') {
+	ost << '\\';
+      }
+      ost << *s;
+    }
+  };
+  Ios_saver guard(ost);
+  ost << std::fixed << std::setprecision(3) << "{\"traceEvents\":[";
+  const char* sep = "\n";
+  Rings::for_each([&](const Ring& ring) {
+    const auto h0 = ring.head.load(std::memory_order_acquire);
+    // the slot after the newest event may be half overwritten
+    const auto n = std::min<std::uint64_t>(h0, capacity - 1);
+    struct Copy
+    {
+      std::uint64_t i;
+      const char* label;
+      std::int64_t begin;
+      std::int64_t dur;
+      int tid;
+    };
+    std::vector<Copy> copy;
+    for (auto i = h0 - n; i != h0; ++i) {
+      const auto& e = ring.events[i % capacity];
+      copy.push_back({i,
+	    e.label.load(std::memory_order_relaxed),
+	    e.begin.load(std::memory_order_relaxed),
+	    e.dur.load(std::memory_order_relaxed),
+	    e.tid.load(std::memory_order_relaxed)});
+    }
+    // drop what the owner overwrote while we copied
+    std::atomic_thread_fence(std::memory_order_acquire);
+    const auto h1 = ring.head.load(std::memory_order_relaxed);
+    for (const auto& c : copy) {
+      if (c.i + capacity <= h1) {
+	continue;
+      }
+      ost << sep << "{\"name\":\"";
+      escape(c.label);
+      ost
+	<< "\",\"ph\":\"X\",\"ts\":" << c.begin/1000.0
+	<< ",\"dur\":" << c.dur/1000.0
+	<< ",\"pid\":" << getpid() << ",\"tid\":" << c.tid << '}';
+      sep = ",\n";
+    }
+  });
+  return ost << "\n],\"displayTimeUnit\":\"ns\"}\n";
+}
+
+inline void tell::Trace::write_exit_file()
+{
+  stop();
+  std::ofstream out(registry().exit_path);
+  write(out);
+}
+
+inline void tell::Trace::write_at_exit(const std::string& path)
+{
+  auto& r = registry();
+  std::lock_guard<std::mutex> lock(r.mutex);
+  if (r.exit_path.empty()) {
+    std::atexit(&write_exit_file);
+  }
+  r.exit_path = path;
+}
@@ -1,16 +1,36 @@
 #pragma once
 
+#include <algorithm>
 #include <array>
+#include <atomic>
 #include <cassert>
 #include <chrono>
 #include <cmath>
+#include <cstdint>
+#include <deque>
 #include <iomanip>
 #include <iostream>
+#include <limits>
 #include <map>
+#include <memory>
+#include <mutex>
+#include <numeric>
+#include <optional>
+#include <set>
 #include <sstream>
+#include <string>
+#include <type_traits>
 #include <vector>
 #include <utility>
 
+#include <time.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <cpuid.h>
+#include <x86intrin.h>
+#endif
+
+#include <tell/meta.h>
+
 namespace tell
 {
   //
@@ -47,6 +67,311 @@ namespace tell
     return find_root<NullGuard, F>(f, x0, x1, tol);
   }
 
+  namespace impl
+  {
+    // bisection steps to shrink a bracket of width w to tol
+    template<typename T>
+    int bisections(T w, T tol)
+    {
+      return std::max(0, static_cast<int>(std::ceil(std::log2(w/tol))));
+    }
+  }
+
+  // the solvers below have the pre-condition and result of find_root
+  // and construct a Guard for every evaluation of f, the two at the
+  // ends of the bracket included; they converge superlinearly on smooth
+  // f, and where find_root evaluates it b = bisections(x1 - x0, tol)
+  // times they evaluate it at most b + 2 + spare times: they have spare
+  // steps more than bisection and keep every point so close to the
+  // midpoint that the bracket left can be bisected in the steps left
+
+  // Brent's method: inverse quadratic or secant step if it lands well
+  // inside the bracket and shrinks it fast enough, else bisection; a
+  // bracket that did not halve over the last two steps is bisected, and
+  // so is every bracket once the steps left would only do for bisection;
+  // 2 spare steps
+  template<typename Guard, typename F, typename T>
+  T find_root_brent(F f, T x0, T x1, T tol)
+  {
+    const auto eval = [&f](T x) {
+      auto guard [[maybe_unused]] = Guard{};
+      return f(x);
+    };
+    T a = x0;
+    T b = x1;
+    T fa = eval(a);
+    T fb = eval(b);
+    // b best guess, [b, c] brackets the zero, a previous b
+    T c = a;
+    T fc = fa;
+    T d = b - a;
+    T e = d;
+    T w1 = std::numeric_limits<T>::infinity();
+    T w2 = w1;
+    for (int k = impl::bisections(x1 - x0, tol) + 2;; --k) {
+      if (std::abs(fc) < std::abs(fb)) {
+	a = b;
+	b = c;
+	c = a;
+	fa = fb;
+	fb = fc;
+	fc = fa;
+      }
+      const T t = 2*std::numeric_limits<T>::epsilon()*std::abs(b) + tol/2;
+      const T m = (c - b)/2;
+      if (std::abs(m) <= t || fb == 0 || k == 0) {
+	return b;
+      }
+      const bool stalled = w2 < 4*std::abs(m) ||
+	k <= impl::bisections(2*std::abs(m), tol);
+      w2 = w1;
+      w1 = 2*std::abs(m);
+      if (!stalled && t <= std::abs(e) && std::abs(fb) < std::abs(fa)) {
+	const T s = fb/fa;
+	T p;
+	T q;
+	if (a == c) {
+	  p = 2*m*s;
+	  q = 1 - s;
+	}
+	else {
+	  const T r = fb/fc;
+	  q = fa/fc;
+	  p = s*(2*m*q*(q - r) - (b - a)*(r - 1));
+	  q = (q - 1)*(r - 1)*(s - 1);
+	}
+	if (0 < p) {
+	  q = -q;
+	}
+	p = std::abs(p);
+	if (2*p < std::min(3*m*q - std::abs(t*q), std::abs(e*q))) {
+	  e = d;
+	  d = p/q;
+	}
+	else {
+	  d = e = m;
+	}
+      }
+      else {
+	d = e = m;
+      }
+      // within r of the midpoint the bracket left fits the steps left
+      const T r = std::max(T(0), std::ldexp(tol/2, k) - std::abs(m));
+      a = b;
+      fa = fb;
+      b += std::clamp(t < std::abs(d) ? d : 0 < m ? t : -t, m - r, m + r);
+      fb = eval(b);
+      if ((0 < fb) == (0 < fc)) {
+	c = a;
+	fc = fa;
+	d = e = b - a;
+      }
+    }
+  }
+
+  template<typename F, typename T>
+  T find_root_brent(F f, T x0, T x1, T tol)
+  {
+    return find_root_brent<NullGuard, F>(f, x0, x1, tol);
+  }
+
+  // regula falsi with the Illinois rule: an end kept twice in a row has
+  // its function value halved; a bracket that did not halve over the
+  // last two steps is bisected; the first steps of regula falsi seldom
+  // halve the bracket, so it has 4 spare steps, and once the steps left
+  // would only do for bisection its points are held near the midpoint
+  // rather than on it
+  template<typename Guard, typename F, typename T>
+  T find_root_illinois(F f, T x0, T x1, T tol)
+  {
+    const auto eval = [&f](T x) {
+      auto guard [[maybe_unused]] = Guard{};
+      return f(x);
+    };
+    T y0 = eval(x0);
+    T y1 = eval(x1);
+    int kept = 0;// -1: x0 kept last step, 1: x1 kept
+    // bracket widths before the last two steps
+    T w1 = std::numeric_limits<T>::infinity();
+    T w2 = w1;
+    for (int k = impl::bisections(x1 - x0, tol) + 4; 0 < k && tol < x1 - x0; --k) {
+      const bool bisect = w2 < 2*(x1 - x0);
+      const T xh = (x0+x1)/2;
+      // within r of the midpoint the bracket left fits the steps left
+      const T r = std::max(T(0), std::ldexp(tol/2, k) - (x1 - x0)/2);
+      const T xm = bisect ? xh :
+	std::clamp(std::clamp((x0*y1 - x1*y0)/(y1 - y0), xh - r, xh + r),
+		   x0 + tol/4, x1 - tol/4);
+      w2 = w1;
+      w1 = x1 - x0;
+      const T ym = eval(xm);
+      if (ym < 0) {
+	x0 = xm;
+	y0 = ym;
+	if (kept == 1) {
+	  y1 /= 2;
+	}
+	kept = 1;
+      }
+      else if (0 < ym) {
+	x1 = xm;
+	y1 = ym;
+	if (kept == -1) {
+	  y0 /= 2;
+	}
+	kept = -1;
+      }
+      else {
+	return xm;
+      }
+    }
+    return (x0+x1)/2;
+  }
+
+  template<typename F, typename T>
+  T find_root_illinois(F f, T x0, T x1, T tol)
+  {
+    return find_root_illinois<NullGuard, F>(f, x0, x1, tol);
+  }
+
+  // interpolate, truncate and project (Oliveira and Takahashi 2020):
+  // the regula falsi point, moved towards the midpoint and kept within
+  // a shrinking distance of it, so that it never needs more than one
+  // step more than bisection
+  template<typename Guard, typename F, typename T>
+  T find_root_itp(F f, T x0, T x1, T tol)
+  {
+    const auto eval = [&f](T x) {
+      auto guard [[maybe_unused]] = Guard{};
+      return f(x);
+    };
+    T y0 = eval(x0);
+    T y1 = eval(x1);
+    const T eps = tol/2;
+    const T k1 = T(0.2)/(x1 - x0);
+    const int n_max = impl::bisections(x1 - x0, tol) + 1;
+    for (int j = 0; j != n_max && tol < x1 - x0; ++j) {
+      const T xh = (x0+x1)/2;
+      const T r = std::ldexp(eps, n_max - j) - (x1 - x0)/2;
+      const T delta = k1*(x1 - x0)*(x1 - x0);
+      const T xf = (x0*y1 - x1*y0)/(y1 - y0);
+      const T sigma = xf < xh ? 1 : -1;
+      const T xt = delta <= std::abs(xh - xf) ? xf + sigma*delta : xh;
+      // at least tol/4 inside, or rounding may leave the bracket as is
+      const T xm = std::clamp(std::abs(xt - xh) <= r ? xt : xh - sigma*r,
+			      x0 + tol/4, x1 - tol/4);
+      const T ym = eval(xm);
+      if (ym < 0) {
+	x0 = xm;
+	y0 = ym;
+      }
+      else if (0 < ym) {
+	x1 = xm;
+	y1 = ym;
+      }
+      else {
+	return xm;
+      }
+    }
+    return (x0+x1)/2;
+  }
+
+  template<typename F, typename T>
+  T find_root_itp(F f, T x0, T x1, T tol)
+  {
+    return find_root_itp<NullGuard, F>(f, x0, x1, tol);
+  }
+
+  // find_root_itp for W problems in lockstep: f maps the W points of a
+  // step to their W values at once, so a loop over lanes in f may be
+  // vectorized; lanes whose bracket is below tol keep it, the others go
+  // on, until all are done; a Guard is constructed per call of f
+  // pre-condition: x0[i] < x1[i], f(x0)[i] < 0 and 0 < f(x1)[i], 0 < tol
+  template<typename Guard, typename F, typename T, std::size_t W>
+  std::array<T,W> find_roots(F f, std::array<T,W> x0, std::array<T,W> x1, T tol)
+  {
+    const auto eval = [&f](const std::array<T,W>& x) {
+      auto guard [[maybe_unused]] = Guard{};
+      return f(x);
+    };
+    std::array<T,W> y0 = eval(x0);
+    std::array<T,W> y1 = eval(x1);
+    const T eps = tol/2;
+    // k1, eps*2^(n_max - j) and n_max - j of find_root_itp, per lane
+    std::array<T,W> k1;
+    std::array<T,W> scale;
+    std::array<int,W> left;
+    for (std::size_t i = 0; i != W; ++i) {
+      k1[i] = T(0.2)/(x1[i] - x0[i]);
+      left[i] = impl::bisections(x1[i] - x0[i], tol) + 1;
+      scale[i] = std::ldexp(eps, left[i]);
+    }
+    // lanes that are done compute a point they will not take
+    int live = 0;
+    for (std::size_t i = 0; i != W; ++i) {
+      live |= tol < x1[i] - x0[i];
+    }
+    std::array<T,W> xm;
+    while (live) {
+      // the arithmetic of a step, all candidates of find_root_itp and
+      // the distances that choose among them, in one loop without
+      // branches that vectorizes; the compiler would not speculate
+      // arithmetic needed on one side of a choice only
+      std::array<T,W> r;
+      std::array<T,W> delta;
+      std::array<T,W> xh;
+      std::array<T,W> xs;
+      std::array<T,W> xp;
+      std::array<T,W> dxf;
+      std::array<T,W> dxs;
+      for (std::size_t i = 0; i != W; ++i) {
+	const T w = x1[i] - x0[i];
+	const T xf = (x0[i]*y1[i] - x1[i]*y0[i])/(y1[i] - y0[i]);
+	r[i] = scale[i] - w/2;
+	delta[i] = k1[i]*w*w;
+	xh[i] = (x0[i]+x1[i])/2;
+	// the sign for xh == xf does not matter, xt is xh then
+	const T sigma = std::copysign(T(1), xh[i] - xf);
+	xs[i] = xf + sigma*delta[i];
+	xp[i] = xh[i] - sigma*r[i];
+	dxf[i] = std::abs(xh[i] - xf);
+	dxs[i] = std::abs(xs[i] - xh[i]);
+	scale[i] /= 2;
+      }
+      for (std::size_t i = 0; i != W; ++i) {
+	const T x = delta[i] <= dxf[i] ? (dxs[i] <= r[i] ? xs[i] : xp[i]) :
+	  0 <= r[i] ? xh[i] : xp[i];
+	const T lo = x0[i] + tol/4;
+	const T hi = x1[i] - tol/4;
+	xm[i] = x < lo ? lo : hi < x ? hi : x;
+      }
+      const std::array<T,W> ym = eval(xm);
+      // a zero closes the bracket on it
+      live = 0;
+      for (std::size_t i = 0; i != W; ++i) {
+	const bool on = 0 < left[i] && tol < x1[i] - x0[i];
+	const bool lo = on && !(0 < ym[i]);
+	const bool hi = on && !(ym[i] < 0);
+	x0[i] = lo ? xm[i] : x0[i];
+	y0[i] = lo ? ym[i] : y0[i];
+	x1[i] = hi ? xm[i] : x1[i];
+	y1[i] = hi ? ym[i] : y1[i];
+	left[i] -= on;
+	live |= 0 < left[i] && tol < x1[i] - x0[i];
+      }
+    }
+    for (std::size_t i = 0; i != W; ++i) {
+      xm[i] = (x0[i]+x1[i])/2;
+    }
+    return xm;
+  }
+
+  template<typename F, typename T, std::size_t W>
+  std::array<T,W> find_roots(F f, std::array<T,W> x0, std::array<T,W> x1, T tol)
+  {
+    return find_roots<NullGuard, F>(f, x0, x1, tol);
+  }
+
   // largest integer with function value smaller than or equal to zero
   // pre-condition: f monotone, n0 < n1, f(n0) <= 0 and 0 < f(n1)
   template<typename Guard, typename F, typename N>
@@ -167,19 +492,134 @@ namespace tell
       pboolmem pbm_;
     };
 
+  //
+  // clocks for Stop_watch and Timer besides the std::chrono ones
+  //
+
+  // time stamp counter, converted to nanoseconds with a factor calibrated
+  // against steady_clock on first use; only meaningful with an invariant
+  // TSC, i.e. one ticking at constant rate in all power states, so the
+  // calibration checks for one and, if the CPU lacks it, now() reads
+  // steady_clock instead for the rest of the process
+  class Tsc_clock
+  {
+  public:
+    using rep = std::int64_t;
+    using period = std::nano;
+    using duration = std::chrono::duration<rep, period>;
+    using time_point = std::chrono::time_point<Tsc_clock>;
+    static constexpr bool is_steady = true;
+    static time_point now();
+    static bool invariant();
+    static std::uint64_t ticks();
+  private:
+    struct Calibration
+    {
+      Calibration();
+      bool tsc = invariant();
+      std::uint64_t t0 = 0;
+      double ns_per_tick = 1.0;
+    };
+    static const Calibration& calibration();
+  };
+
+  // CLOCK_MONOTONIC_COARSE: cheap to read, resolution of a timer tick
+  class Coarse_clock
+  {
+  public:
+    using rep = std::int64_t;
+    using period = std::nano;
+    using duration = std::chrono::duration<rep, period>;
+    using time_point = std::chrono::time_point<Coarse_clock>;
+    static constexpr bool is_steady = true;
+    static time_point now();
+  };
+
+  // median time between two successive readings of Clock, measured at
+  // startup; Timer subtracts it from every sample
+  template<typename Clock>
+    inline const typename Clock::duration clock_overhead = [] {
+      std::array<typename Clock::duration, 1001> d;
+      for (auto& x : d) {
+	const auto t = Clock::now();
+	x = Clock::now() - t;
+      }
+      std::nth_element(d.begin(), d.begin() + d.size()/2, d.end());
+      return d[d.size()/2];
+    }();
+
+  namespace impl
+  {
+    // while set, called with label and duration in nanoseconds at the
+    // end of every Stop_watch and Timer scope (see tell/trace.h)
+    using Scope_hook = void (*)(const char* label, std::int64_t ns);
+    inline std::atomic<Scope_hook> scope_hook{nullptr};
+
+    // while set, Stop_watch hands its result to this sink instead of
+    // writing it to std::cout (see tell/report.h)
+    using Report_sink = void (*)(const char* label, long long count,
+				 const char* unit);
+    inline std::atomic<Report_sink> report_sink{nullptr};
+
+    template<typename D>
+      void call_scope_hook(const char* label, D d)
+      {
+	if (const auto h = scope_hook.load(std::memory_order_relaxed)) {
+	  h(label, std::chrono::duration_cast<std::chrono::nanoseconds>(d)
+	    .count());
+	}
+      }
+
+    // state of the Switch: zero while everything is on
+    inline constexpr unsigned all_off = 1;
+    inline constexpr unsigned some_off = 2;
+    inline std::atomic<unsigned> switches{0};
+
+    bool active();
+    bool active(const char* label);
+  }
+
+  // run-time switch of Timer, Sampled_timer, Stop_watch, Counter,
+  // Tracking_engine, Flight_timer, Profile and Profiled_mutex, for all
+  // of them or per label; while everything is
+  // on, a scope pays one predictable branch on a read-mostly flag, only
+  // while labels are off is the label looked up; a scope is switched
+  // when it starts
+  class Switch
+  {
+  public:
+    static void enable(bool on = true);
+    static void enable(const char* label, bool on = true);
+    static bool enabled();
+    static bool enabled(const char* label);
+  private:
+    using Labels = std::set<std::string, std::less<>>;
+    // versions of the labels switched off; readers use the newest
+    // without locking, so older ones are kept until exit
+    struct Registry
+    {
+      std::mutex mutex;
+      std::vector<std::unique_ptr<const Labels>> versions;
+      std::atomic<const Labels*> off{nullptr};
+    };
+    static Registry& registry();
+  };
+
   //
   // simple timer
   //
-  template<typename P = std::chrono::microseconds>
+  template<typename P = std::chrono::microseconds,
+    typename Clock = std::chrono::high_resolution_clock>
     class Stop_watch
     {
-      using Clock = std::chrono::high_resolution_clock;
     public:
       Stop_watch(const char* label = "run");
       ~Stop_watch();
     private:
       const char* label;
-      Clock::time_point t = Clock::now();
+      const bool on = impl::active(label);
+      typename Clock::time_point t = on ? Clock::now()
+	: typename Clock::time_point{};
     };
 
   template<typename P>
@@ -198,36 +638,318 @@ namespace tell
   {
   public:
     Avg& operator<<(double x);
+    // bulk ingestion, block-wise two-pass instead of recursive update
+    Avg& operator<<(const std::vector<double>& v);
+    Avg& add(const double* x, std::size_t m);
+    // merge with statistics of another sample (Chan et al.)
+    Avg& operator+=(const Avg& a);
     std::pair<double,double> operator()() const;
+    std::size_t count() const;
+    double min() const;
+    double max() const;
   private:
     std::size_t n = 0;
     double mu = 0;
     double var = 0;
+    double lo = HUGE_VAL;
+    double hi = -HUGE_VAL;
+  };
+
+  // log-linear bucketed recorder for latency quantiles (HDR style):
+  // every power of two is split into 2^bits linear buckets, so the
+  // relative error is below 2^-bits and recording takes constant time
+  class Latency_histo
+  {
+  public:
+    static constexpr int bits = 5;
+    static constexpr int octaves = 48;
+    Latency_histo& operator<<(double x);
+    Latency_histo& operator+=(const Latency_histo& h);
+    std::size_t count() const;
+    double mean() const;
+    double max() const;
+    // smallest bucket bound with at least a fraction q of the samples below
+    double quantile(double q) const;
+  private:
+    static constexpr std::size_t sub = std::size_t{1} << bits;
+    static constexpr std::size_t size = (octaves - bits + 1)*sub;
+    static std::size_t index(std::uint64_t v);
+    static double upper(std::size_t i);
+    std::array<std::uint64_t, size> freq{};
+    std::size_t n = 0;
+    double sum = 0;
+    double hi = 0;
+  };
+
+  // Avg of the samples of the last slots*width_ms milliseconds: a ring
+  // of per-slot Avgs, each tagged with the time slot it covers, where a
+  // slot is cleared when its time comes round again
+  template<std::size_t slots = 60, std::int64_t width_ms = 1000>
+  class Window_avg
+  {
+  public:
+    Window_avg& operator<<(double x);
+    Window_avg& operator+=(const Window_avg& w);
+    // the samples in the window as of now
+    Avg window() const;
+    std::pair<double,double> operator()() const;
+    std::size_t count() const;
+  private:
+    static std::int64_t epoch();
+    std::array<Avg, slots> ring;
+    std::array<std::int64_t, slots> tag{};
+  };
+
+  // average and deviation with exponentially decaying weights: a sample
+  // counts half after half_life_ms milliseconds
+  template<std::int64_t half_life_ms = 10000>
+  class Decayed_avg
+  {
+  public:
+    Decayed_avg& operator<<(double x);
+    Decayed_avg& operator+=(const Decayed_avg& d);
+    std::pair<double,double> operator()() const;
+    // total weight of the samples as of now
+    double weight() const;
+  private:
+    void decay(std::int64_t to);
+    double w = 0;
+    double mu = 0;
+    double m2 = 0;// weighted sum of squared deviations
+    std::int64_t t = 0;// time of last update, ns of Coarse_clock
+  };
+
+  // two statistics fed with the same samples, e.g. Both<Avg, Latency_histo>
+  template<typename A, typename B>
+    struct Both
+    {
+      Both& operator<<(double x);
+      Both& operator+=(const Both& b);
+      A first;
+      B second;
+    };
+
+  namespace impl
+  {
+    // alignment that keeps per-thread data off each other's cache lines
+    inline constexpr std::size_t cache_line = 64;
+
+    // dense numbering of labels in order of registration
+    class Labels
+    {
+    public:
+      static constexpr std::size_t none = -1;
+      static std::size_t add(const char* name);
+      static const char* name(std::size_t slot);
+    private:
+      struct Registry
+      {
+	std::mutex mutex;
+	std::vector<const char*> names;
+      };
+      static Registry& registry();
+    };
+
+    // slot of a compile-time label, equal texts share a slot program-wide;
+    // assigned on first use, so static initialization order doesn't matter
+    template<typename L>
+      std::size_t label_slot();
+
+    // accumulators keyed by label, one shard per thread, merged by label
+    // text on demand; the owning thread updates its shard without locking
+    // and a seqlock lets readers copy the (trivially copyable) Acc
+    template<typename Tag, typename Acc>
+      class Sharded
+      {
+	static_assert(std::is_trivially_copyable<Acc>::value);
+      public:
+	template<typename X> static void add(const char* label, const X& x);
+	template<typename X> static void add(std::size_t slot, const X& x);
+	static std::map<std::string, Acc> merge();
+      private:
+	struct alignas(cache_line) Shard
+	{
+	  Shard();
+	  ~Shard();
+	  template<typename X> void update(Acc& acc, const X& x);
+	  Acc read(const Acc& acc) const;
+	  std::atomic<unsigned> seq{0};
+	  std::map<const char*, Acc> stats;
+	  std::vector<Acc> slots;
+	  std::vector<char> used;
+	};
+	// shards of running threads and totals of finished ones
+	struct Registry
+	{
+	  std::mutex mutex;
+	  std::vector<Shard*> live;
+	  std::map<std::string, Acc> retired;
+	};
+	static Registry& registry();
+	static Shard& local();
+      };
+
+    // objects of T that outlive the thread using them, so that they can
+    // be read after it exited, and that go to the next new thread then,
+    // so that there are no more than threads at once; every thread that
+    // takes one gets a number of its own, from 1 in order of arrival
+    template<typename T>
+      class Recycled
+      {
+      public:
+	struct Use
+	{
+	  T* object = nullptr;
+	  int tid = 0;
+	};
+	// the object of the calling thread and the thread's number
+	static const Use& local();
+	// f(T&) for every object, with none handed over meanwhile
+	template<typename F> static void for_each(F f);
+      private:
+	// hands the object back when its thread exits
+	struct Owner : Use
+	{
+	  ~Owner();
+	};
+	struct Registry
+	{
+	  std::mutex mutex;
+	  std::vector<std::unique_ptr<T>> objects;
+	  std::vector<T*> free;
+	  int threads = 0;
+	};
+	static Registry& registry();
+      };
+  }
+
+  // extra measurement of a Timer scope besides time: a probe starts
+  // measuring when constructed, before the clock is read, and
+  // bool stop(Sample&) ends it after the clock is read; the samples go
+  // into the probe's Acc and print(ostream&, const Acc&) reports them
+  struct No_probe
+  {
+    struct Sample {};
+    struct Acc {};
   };
 
-  // timer with statistics
-  template<typename P = std::chrono::microseconds>
+  // timer with statistics, usable concurrently from several threads;
+  // Acc is Avg, Window_avg, Decayed_avg, Latency_histo or a combination
+  // of them with Both;
+  // compile-time labels ("parse"_S) are recorded by array index;
+  // the clock's own overhead is subtracted from each sample
+  template<typename P = std::chrono::microseconds, typename Acc = Avg,
+    typename Clock = std::chrono::high_resolution_clock,
+    typename Probe = No_probe>
     class Timer
     {
-      using Clock = std::chrono::high_resolution_clock;
+      using Stats = impl::Sharded<Timer, Acc>;
+      struct Probe_tag;
+      using Probe_stats = impl::Sharded<Probe_tag, typename Probe::Acc>;
+      static constexpr bool probing = !std::is_same<Probe, No_probe>::value;
     public:
+      using duration = P;
       Timer(const char* label = "run");
+      template<char... C> Timer(ct_string<C...> label);
       ~Timer();
+      static std::map<std::string, Acc> stats();
+      static std::map<std::string, typename Probe::Acc> probe_stats();
+      static std::ostream& print_stats(std::ostream&, bool seqno = false);
+    private:
+      void start();
+      const char* const label;
+      const std::size_t slot = impl::Labels::none;
+      const bool on = impl::active(label);
+      std::optional<Probe> probe;
+      typename Clock::time_point t;
+    };
+
+  // which entries of a Sampled_timer read the clock
+  enum class Sampling { every, random };
+
+  // timer for scopes too hot to time on every entry: a thread reads the
+  // clock on every Nth entry of a label only (Sampling::random: on a random 1 in N,
+  // which avoids aliasing with periodic work); N is the template
+  // argument or, if that is 0, set at run time with rate(); each sample
+  // stands for the gap of entries that led to it and is weighted with
+  // the rate that scheduled that gap, so the estimated calls stay
+  // unbiased across a change of rate
+  template<std::size_t N = 0, Sampling S = Sampling::every,
+    typename P = std::chrono::microseconds, typename Acc = Avg,
+    typename Clock = std::chrono::high_resolution_clock>
+    class Sampled_timer
+    {
+      using Stats = impl::Sharded<Sampled_timer, Acc>;
+      // estimated number of calls, i.e. samples weighted with the rate
+      struct Calls
+      {
+	Calls& operator<<(double w);
+	Calls& operator+=(const Calls& c);
+	double n = 0;
+      };
+      using Call_stats = impl::Sharded<Calls, Calls>;
+    public:
+      using duration = P;
+      Sampled_timer(const char* label = "run");
+      template<char... C> Sampled_timer(ct_string<C...> label);
+      ~Sampled_timer();
+      static void rate(std::size_t n);
+      static std::size_t rate();
+      static std::map<std::string, Acc> stats();
+      static std::map<std::string, double> calls();
       static std::ostream& print_stats(std::ostream&, bool seqno = false);
     private:
-      static inline std::map<const char*, Avg> stats;
+      // entries left until the next sample and the rate that scheduled
+      // it, which the sample is weighted with
+      struct Countdown
+      {
+	std::size_t left;
+	std::size_t rate;
+      };
+      static std::size_t next(std::size_t n);
+      // per thread and label; kept in place for the thread's lifetime
+      static Countdown& countdown(std::size_t slot, const char* label);
+      template<typename L>
+	static Countdown* local(std::size_t slot, const char* label);
+      template<typename L>
+	static inline thread_local Countdown* cell_ = nullptr;
+      static inline thread_local const char* last_label = nullptr;
+      static inline thread_local Countdown* last_cell = nullptr;
+      static inline std::atomic<std::size_t> rate_{N == 0 ? 1024 : N};
+      static inline thread_local std::uint64_t seed = 0;
       const char* const label;
-      Clock::time_point t = Clock::now();
+      const std::size_t slot = impl::Labels::none;
+      Countdown* const cell;
+      const bool sampled = cell && --cell->left == 0;
+      typename Clock::time_point t = sampled ? Clock::now()
+	: typename Clock::time_point{};
     };
 
-  // for counting function calls / loop iterations
+  // for counting function calls / loop iterations; compiled in unless
+  // NDEBUG is set, define TELL_COUNTERS to keep them in release builds;
+  // each thread counts into its own relaxed cells, summed on demand
   struct Counter_base
   {
+    static std::map<std::string, std::size_t> stats();
     static std::ostream& print_stats(std::ostream&);
   protected:
-#ifndef NDEBUG
-    static inline std::map<const char*, std::size_t> stats; 
-#endif
+    using Cell = std::atomic<std::size_t>;
+    static Cell& cell(std::size_t slot);
+  private:
+    struct alignas(impl::cache_line) Shard
+    {
+      Shard();
+      ~Shard();
+      std::deque<Cell> cells;// grows without moving cells
+    };
+    struct Registry
+    {
+      std::mutex mutex;
+      std::vector<Shard*> live;
+      std::vector<std::size_t> retired;
+    };
+    static Registry& registry();
+    static Shard& local();
   };
   
   template<const char* label>
@@ -235,6 +957,9 @@ namespace tell
     {
       Counter() = default;
       ~Counter();
+    private:
+      static std::size_t slot();
+      static inline thread_local Cell* count = nullptr;
     };
   
   // simple histograms
@@ -245,10 +970,77 @@ namespace tell
     Histo& operator<<(I);
     Histo& operator<<(const std::vector<I>& v);
     std::ostream& print(std::ostream& ost) const;
+    // frequency of each value seen
+    std::map<I, std::size_t> bins() const;
   private:
     std::map<I, std::size_t> freq;
   };
 
+  // histogram of integers in [lo, hi] kept in a flat array; samples
+  // outside the range are counted below and above it
+  template<typename I>
+  class Dense_histo
+  {
+  public:
+    Dense_histo(I lo, I hi);
+    Dense_histo& operator<<(I i);
+    Dense_histo& operator<<(const std::vector<I>& v);
+    Dense_histo& add(const I* x, std::size_t n);
+    std::ostream& print(std::ostream& ost) const;
+    std::map<I, std::size_t> bins() const;
+    std::size_t below() const;
+    std::size_t above() const;
+  private:
+    std::size_t index(I i) const;
+    I lo;
+    // freq[0] and freq.back() count the samples out of range
+    std::vector<std::size_t> freq;
+  };
+
+  // histogram of integers of any magnitude: 2^bits buckets per power
+  // of two, so that a bucket is exact up to 2^bits and within a relative
+  // 2^-bits above; buckets are keyed by their bound nearest to zero
+  template<typename I, int bits = 2>
+  class Log_histo
+  {
+  public:
+    Log_histo& operator<<(I i);
+    Log_histo& operator<<(const std::vector<I>& v);
+    Log_histo& add(const I* x, std::size_t n);
+    std::ostream& print(std::ostream& ost) const;
+    std::map<I, std::size_t> bins() const;
+  private:
+    static constexpr std::size_t sub = std::size_t{1} << bits;
+    // buckets per sign, magnitudes up to 2^64
+    static constexpr std::size_t half = (64 - bits + 1)*sub;
+    static std::size_t index(I i);
+    static I key(std::size_t k);
+    // negative magnitudes mirrored below half, so that buckets are
+    // ordered like their values
+    std::array<std::size_t, 2*half> freq{};
+    template<typename, int, std::size_t> friend class Concurrent_histo;
+  };
+
+  // Log_histo that threads record into without locks: each thread
+  // counts into one of the cache-line aligned stripes of buckets with
+  // relaxed atomic increments, reading sums the stripes
+  template<typename I, int bits = 2, std::size_t stripes = 8>
+  class Concurrent_histo
+  {
+  public:
+    Concurrent_histo& operator<<(I i);
+    Log_histo<I,bits> snapshot() const;
+    std::ostream& print(std::ostream& ost) const;
+    std::map<I, std::size_t> bins() const;
+  private:
+    using Buckets = Log_histo<I,bits>;
+    struct alignas(impl::cache_line) Stripe
+    {
+      std::array<std::atomic<std::size_t>, 2*Buckets::half> freq{};
+    };
+    std::array<Stripe, stripes> stripe;
+  };
+
   //
   // stream input/output for std::vectors
   //
@@ -329,111 +1121,1124 @@ tell::Testable<T>::operator bool_type() const
   return This->*pbm_ ? &Testable::bool_type_fun : nullptr;
 }
 
-template<typename P>
-tell::Stop_watch<P>::Stop_watch(const char* label)
-: label(label)
+inline tell::Tsc_clock::time_point tell::Tsc_clock::now()
 {
+  const auto& c = calibration();
+  if (__builtin_expect(!c.tsc, 0)) {
+    return time_point(std::chrono::duration_cast<duration>(
+      std::chrono::steady_clock::now().time_since_epoch()));
+  }
+  return time_point(duration(static_cast<rep>((ticks() - c.t0)*c.ns_per_tick)));
 }
 
-template<typename P>
-tell::Stop_watch<P>::~Stop_watch()
+inline std::uint64_t tell::Tsc_clock::ticks()
 {
-  const auto d = Clock::now() - t;
-  std::cout 
-    << "timing for " << std::right << std::setw(12) << label << ": "
-    << std::right << std::setw(20)
-    << std::chrono::duration_cast<P>(d).count() 
-    << precision<P> << std::endl;
+#if defined(__x86_64__) || defined(__i386__)
+  return __rdtsc();
+#else
+  return std::chrono::steady_clock::now().time_since_epoch().count();
+#endif
 }
 
-inline tell::Avg& tell::Avg::operator<<(double x)
+inline bool tell::Tsc_clock::invariant()
 {
-  const double h{n == 0 ? 0.0 : 1.0/n};
-  ++n;
-  mu += (x-mu)/n;
-  const double d{x-mu};
-  var += h*d*d - var/n;
-  return *this;
+#if defined(__x86_64__) || defined(__i386__)
+  unsigned a, b, c, d;
+  return __get_cpuid(0x80000007, &a, &b, &c, &d) && (d & (1u << 8));
+#else
+  return false;
+#endif
 }
 
-inline std::pair<double,double> tell::Avg::operator()() const
+inline tell::Tsc_clock::Calibration::Calibration()
 {
-  return {mu, std::sqrt(var)};
+  if (!tsc) {
+    return;
+  }
+  using Steady = std::chrono::steady_clock;
+  const auto s0 = Steady::now();
+  t0 = ticks();
+  auto s1 = s0;
+  while (s1 - s0 < std::chrono::milliseconds(10)) {
+    s1 = Steady::now();
+  }
+  const auto t1 = ticks();
+  const std::chrono::duration<double, std::nano> d = s1 - s0;
+  ns_per_tick = t1 == t0 ? 1.0 : d.count()/(t1 - t0);
 }
 
-template<typename P>
-tell::Timer<P>::Timer(const char* label)
-: label(label)
+inline const tell::Tsc_clock::Calibration& tell::Tsc_clock::calibration()
 {
+  static const Calibration c;
+  return c;
 }
 
-template<typename P>
-tell::Timer<P>::~Timer()
+inline tell::Coarse_clock::time_point tell::Coarse_clock::now()
 {
-  const auto d = Clock::now() - t;
-  const double x = std::chrono::duration_cast<P>(d).count();
-  stats[label] << x;
+  timespec ts;
+#ifdef CLOCK_MONOTONIC_COARSE
+  clock_gettime(CLOCK_MONOTONIC_COARSE, &ts);
+#else
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+#endif
+  return time_point(duration(ts.tv_sec*rep{1'000'000'000} + ts.tv_nsec));
 }
 
-template<typename P>
-std::ostream& tell::Timer<P>::print_stats(std::ostream& ost, bool seqno)
+inline bool tell::impl::active()
 {
-  std::size_t i = 0;
-  for (const auto& p : stats) {
-    double mu, sigma;
-    std::tie(mu, sigma) = (p.second)();
-    ost
-      << "timing for " << std::right << std::setw(10) << p.first;
-    if (seqno) {
-      ost
-	<< " (" << std::right << std::setw(2) << i++ << ')';
-    }
-    ost
-      << std::right << std::setw(15) << mu << precision<P>
-      << " +-" << std::right << std::setw(8) << sigma << '\n';
+  return !(switches.load(std::memory_order_relaxed) & all_off);
+}
+
+inline bool tell::impl::active(const char* label)
+{
+  if (__builtin_expect(switches.load(std::memory_order_relaxed) == 0, 1)) {
+    return true;
   }
-  return ost;
+  return Switch::enabled(label);
 }
 
-template<const char* label>
-tell::Counter<label>::~Counter()
+inline tell::Switch::Registry& tell::Switch::registry()
 {
-#ifndef NDEBUG
-  stats[label]++;
-#endif
+  static Registry r;
+  return r;
 }
 
-inline std::ostream& tell::Counter_base::print_stats(std::ostream& ost)
+inline void tell::Switch::enable(bool on)
 {
-#ifndef NDEBUG
-  for (const auto& p : stats) {
-    ost
-      << "count for " << std::right << std::setw(15) << p.first << ": "
-      << std::right << std::setw(10) << p.second
-      << '\n';
+  if (on) {
+    impl::switches.fetch_and(~impl::all_off, std::memory_order_relaxed);
+  }
+  else {
+    impl::switches.fetch_or(impl::all_off, std::memory_order_relaxed);
   }
-#endif
-  return ost;
 }
 
-template<typename I>
-tell::Histo<I>& tell::Histo<I>::operator<<(I i)
+inline void tell::Switch::enable(const char* label, bool on)
 {
-  freq[i]++;
-  return *this;
+  auto& r = registry();
+  std::lock_guard<std::mutex> lock(r.mutex);
+  const auto old = r.off.load(std::memory_order_relaxed);
+  auto off = old ? std::make_unique<Labels>(*old) : std::make_unique<Labels>();
+  if (on) {
+    off->erase(label);
+  }
+  else {
+    off->emplace(label);
+  }
+  const bool some = !off->empty();
+  r.off.store(off.get(), std::memory_order_release);
+  r.versions.push_back(std::move(off));
+  if (some) {
+    impl::switches.fetch_or(impl::some_off, std::memory_order_release);
+  }
+  else {
+    impl::switches.fetch_and(~impl::some_off, std::memory_order_release);
+  }
 }
 
-template<typename I>
-tell::Histo<I>& tell::Histo<I>::operator<<(const std::vector<I>& v)
+inline bool tell::Switch::enabled()
 {
-  for (auto i : v) {
-    *this << i;
+  return impl::active();
+}
+
+inline bool tell::Switch::enabled(const char* label)
+{
+  if (!impl::active()) {
+    return false;
   }
-  return *this;
+  if (!(impl::switches.load(std::memory_order_acquire) & impl::some_off)) {
+    return true;
+  }
+  const auto off = registry().off.load(std::memory_order_acquire);
+  return !off || off->find(label) == off->end();
 }
 
-template<typename I>
-std::ostream& tell::Histo<I>::print(std::ostream& ost) const
+template<typename P, typename Clock>
+tell::Stop_watch<P,Clock>::Stop_watch(const char* label)
+: label(label)
+{
+}
+
+template<typename P, typename Clock>
+tell::Stop_watch<P,Clock>::~Stop_watch()
+{
+  if (!on) {
+    return;
+  }
+  const auto d = Clock::now() - t;
+  impl::call_scope_hook(label, d);
+  const long long n = std::chrono::duration_cast<P>(d).count();
+  if (const auto s = impl::report_sink.load(std::memory_order_relaxed)) {
+    s(label, n, precision<P>);
+    return;
+  }
+  std::cout 
+    << "timing for " << std::right << std::setw(12) << label << ": "
+    << std::right << std::setw(20)
+    << n
+    << precision<P> << std::endl;
+}
+
+inline tell::Avg& tell::Avg::operator<<(double x)
+{
+  const double h{n == 0 ? 0.0 : 1.0/n};
+  ++n;
+  mu += (x-mu)/n;
+  const double d{x-mu};
+  var += h*d*d - var/n;
+  lo = x < lo ? x : lo;
+  hi = hi < x ? x : hi;
+  return *this;
+}
+
+inline tell::Avg& tell::Avg::operator<<(const std::vector<double>& v)
+{
+  return add(v.data(), v.size());
+}
+
+inline tell::Avg& tell::Avg::add(const double* x, std::size_t m)
+{
+  // blocks stay in cache for the second pass; the w independent lanes
+  // break the dependency chains, so the loops vectorise
+  constexpr std::size_t block = 2048;
+  constexpr std::size_t w = 8;
+  for (std::size_t b = 0; b < m; b += block) {
+    const double* y = x + b;
+    const std::size_t k = std::min(block, m - b);
+    const std::size_t kw = k - k%w;
+    double s[w] = {};
+    double l[w];
+    double h[w];
+    std::fill(l, l+w, HUGE_VAL);
+    std::fill(h, h+w, -HUGE_VAL);
+    for (std::size_t i = 0; i != kw; i += w) {
+      for (std::size_t j = 0; j != w; ++j) {
+	s[j] += y[i+j];
+	l[j] = y[i+j] < l[j] ? y[i+j] : l[j];
+	h[j] = h[j] < y[i+j] ? y[i+j] : h[j];
+      }
+    }
+    for (std::size_t i = kw; i != k; ++i) {
+      s[0] += y[i];
+      l[0] = y[i] < l[0] ? y[i] : l[0];
+      h[0] = h[0] < y[i] ? y[i] : h[0];
+    }
+    Avg a;
+    a.n = k;
+    a.mu = std::accumulate(s, s+w, 0.0)/k;
+    a.lo = *std::min_element(l, l+w);
+    a.hi = *std::max_element(h, h+w);
+    double q[w] = {};
+    for (std::size_t i = 0; i != kw; i += w) {
+      for (std::size_t j = 0; j != w; ++j) {
+	const double d = y[i+j] - a.mu;
+	q[j] += d*d;
+      }
+    }
+    for (std::size_t i = kw; i != k; ++i) {
+      const double d = y[i] - a.mu;
+      q[0] += d*d;
+    }
+    a.var = std::accumulate(q, q+w, 0.0)/k;
+    *this += a;
+  }
+  return *this;
+}
+
+inline tell::Avg& tell::Avg::operator+=(const Avg& a)
+{
+  if (a.n == 0) {
+    return *this;
+  }
+  const double na = n;
+  const double nb = a.n;
+  const double d{a.mu-mu};
+  n += a.n;
+  mu += d*nb/n;
+  var = (na*var + nb*a.var + d*d*na*nb/n)/n;
+  lo = a.lo < lo ? a.lo : lo;
+  hi = hi < a.hi ? a.hi : hi;
+  return *this;
+}
+
+inline std::pair<double,double> tell::Avg::operator()() const
+{
+  return {mu, std::sqrt(var)};
+}
+
+inline std::size_t tell::Avg::count() const
+{
+  return n;
+}
+
+inline double tell::Avg::min() const
+{
+  return lo;
+}
+
+inline double tell::Avg::max() const
+{
+  return hi;
+}
+
+inline tell::Latency_histo& tell::Latency_histo::operator<<(double x)
+{
+  const double y = x < 0 ? 0.0 : x;
+  const std::uint64_t v = y < 0x1p63 ? static_cast<std::uint64_t>(y) : ~0ull;
+  ++freq[index(v)];
+  ++n;
+  sum += y;
+  hi = std::max(hi, y);
+  return *this;
+}
+
+inline tell::Latency_histo&
+tell::Latency_histo::operator+=(const Latency_histo& h)
+{
+  for (std::size_t i = 0; i != size; ++i) {
+    freq[i] += h.freq[i];
+  }
+  n += h.n;
+  sum += h.sum;
+  hi = std::max(hi, h.hi);
+  return *this;
+}
+
+inline std::size_t tell::Latency_histo::count() const
+{
+  return n;
+}
+
+inline double tell::Latency_histo::mean() const
+{
+  return n == 0 ? 0.0 : sum/n;
+}
+
+inline double tell::Latency_histo::max() const
+{
+  return hi;
+}
+
+inline double tell::Latency_histo::quantile(double q) const
+{
+  const auto rank = static_cast<std::uint64_t>(std::ceil(q*n));
+  std::uint64_t cum = 0;
+  for (std::size_t i = 0; i != size; ++i) {
+    cum += freq[i];
+    if (cum != 0 && rank <= cum) {
+      return std::min(upper(i), hi);
+    }
+  }
+  return hi;
+}
+
+inline std::size_t tell::Latency_histo::index(std::uint64_t v)
+{
+  if (v < sub) {
+    return v;
+  }
+  const int msb = 63 - __builtin_clzll(v);
+  if (octaves <= msb) {
+    return size - 1;
+  }
+  const int shift = msb - bits;
+  return (shift+1)*sub + ((v >> shift) - sub);
+}
+
+inline double tell::Latency_histo::upper(std::size_t i)
+{
+  if (i < sub) {
+    return i;
+  }
+  const int shift = i/sub - 1;
+  const double width = std::ldexp(1.0, shift);
+  return (i%sub + sub)*width + width - 1;
+}
+
+template<std::size_t slots, std::int64_t width_ms>
+std::int64_t tell::Window_avg<slots,width_ms>::epoch()
+{
+  const std::int64_t width = width_ms*1000000;
+  return Coarse_clock::now().time_since_epoch().count()/width;
+}
+
+template<std::size_t slots, std::int64_t width_ms>
+tell::Window_avg<slots,width_ms>&
+tell::Window_avg<slots,width_ms>::operator<<(double x)
+{
+  const auto e = epoch();
+  const auto i = e%slots;
+  if (tag[i] != e) {
+    tag[i] = e;
+    ring[i] = Avg();
+  }
+  ring[i] << x;
+  return *this;
+}
+
+template<std::size_t slots, std::int64_t width_ms>
+tell::Window_avg<slots,width_ms>&
+tell::Window_avg<slots,width_ms>::operator+=(const Window_avg& w)
+{
+  for (std::size_t i = 0; i != slots; ++i) {
+    if (tag[i] < w.tag[i]) {
+      tag[i] = w.tag[i];
+      ring[i] = w.ring[i];
+    }
+    else if (tag[i] == w.tag[i]) {
+      ring[i] += w.ring[i];
+    }
+  }
+  return *this;
+}
+
+template<std::size_t slots, std::int64_t width_ms>
+tell::Avg tell::Window_avg<slots,width_ms>::window() const
+{
+  const auto e = epoch();
+  Avg a;
+  for (std::size_t i = 0; i != slots; ++i) {
+    if (e - static_cast<std::int64_t>(slots) < tag[i]) {
+      a += ring[i];
+    }
+  }
+  return a;
+}
+
+template<std::size_t slots, std::int64_t width_ms>
+std::pair<double,double> tell::Window_avg<slots,width_ms>::operator()() const
+{
+  return window()();
+}
+
+template<std::size_t slots, std::int64_t width_ms>
+std::size_t tell::Window_avg<slots,width_ms>::count() const
+{
+  return window().count();
+}
+
+template<std::int64_t half_life_ms>
+void tell::Decayed_avg<half_life_ms>::decay(std::int64_t to)
+{
+  if (t < to) {
+    const double f = std::exp2((t - to)/(half_life_ms*1e6));
+    w *= f;
+    m2 *= f;
+    t = to;
+  }
+}
+
+template<std::int64_t half_life_ms>
+tell::Decayed_avg<half_life_ms>&
+tell::Decayed_avg<half_life_ms>::operator<<(double x)
+{
+  // the coarse clock ticks every few ms, so most samples skip the exp2
+  decay(Coarse_clock::now().time_since_epoch().count());
+  w += 1;
+  const double d = x - mu;
+  mu += d/w;
+  m2 += d*(x - mu);
+  return *this;
+}
+
+template<std::int64_t half_life_ms>
+tell::Decayed_avg<half_life_ms>&
+tell::Decayed_avg<half_life_ms>::operator+=(const Decayed_avg& a)
+{
+  auto b = a;
+  decay(b.t);
+  b.decay(t);
+  if (b.w == 0) {
+    return *this;
+  }
+  const double wa = w;
+  const double d = b.mu - mu;
+  w += b.w;
+  mu += d*b.w/w;
+  m2 += b.m2 + d*d*wa*b.w/w;
+  return *this;
+}
+
+template<std::int64_t half_life_ms>
+std::pair<double,double> tell::Decayed_avg<half_life_ms>::operator()() const
+{
+  // decay changes the weights only, not their ratios
+  return {mu, w == 0 ? 0.0 : std::sqrt(std::max(m2/w, 0.0))};
+}
+
+template<std::int64_t half_life_ms>
+double tell::Decayed_avg<half_life_ms>::weight() const
+{
+  auto a = *this;
+  a.decay(Coarse_clock::now().time_since_epoch().count());
+  return a.w;
+}
+
+template<typename A, typename B>
+tell::Both<A,B>& tell::Both<A,B>::operator<<(double x)
+{
+  first << x;
+  second << x;
+  return *this;
+}
+
+template<typename A, typename B>
+tell::Both<A,B>& tell::Both<A,B>::operator+=(const Both& b)
+{
+  first += b.first;
+  second += b.second;
+  return *this;
+}
+
+namespace tell::impl
+{
+  inline std::ostream&
+  print_stat(std::ostream& ost, const Avg& a, const char* unit)
+  {
+    double mu, sigma;
+    std::tie(mu, sigma) = a();
+    return ost
+      << std::right << std::setw(15) << mu << unit
+      << " +-" << std::right << std::setw(8) << sigma;
+  }
+
+  inline std::ostream&
+  print_stat(std::ostream& ost, const Latency_histo& h, const char* unit)
+  {
+    const std::pair<const char*, double> qs[] = {
+      {"p50", 0.5}, {"p90", 0.9}, {"p99", 0.99}, {"p99.9", 0.999}
+    };
+    for (const auto& q : qs) {
+      ost
+	<< ' ' << q.first << std::right << std::setw(10)
+	<< h.quantile(q.second) << unit;
+    }
+    return ost
+      << " max" << std::right << std::setw(10) << h.max() << unit;
+  }
+
+  template<std::size_t slots, std::int64_t width_ms>
+    std::ostream& print_stat(std::ostream& ost,
+			     const Window_avg<slots,width_ms>& w,
+			     const char* unit)
+  {
+    return print_stat(ost, w.window(), unit);
+  }
+
+  template<std::int64_t half_life_ms>
+    std::ostream& print_stat(std::ostream& ost,
+			     const Decayed_avg<half_life_ms>& d,
+			     const char* unit)
+  {
+    double mu, sigma;
+    std::tie(mu, sigma) = d();
+    return ost
+      << std::right << std::setw(15) << mu << unit
+      << " +-" << std::right << std::setw(8) << sigma;
+  }
+
+  template<typename A, typename B>
+    std::ostream&
+    print_stat(std::ostream& ost, const Both<A,B>& b, const char* unit)
+  {
+    print_stat(ost, b.first, unit);
+    return print_stat(ost, b.second, unit);
+  }
+}
+
+inline std::size_t tell::impl::Labels::add(const char* name)
+{
+  auto& r = registry();
+  std::lock_guard<std::mutex> lock(r.mutex);
+  r.names.push_back(name);
+  return r.names.size() - 1;
+}
+
+template<typename L>
+std::size_t tell::impl::label_slot()
+{
+  static const std::size_t slot = Labels::add(L{}.c_str());
+  return slot;
+}
+
+inline const char* tell::impl::Labels::name(std::size_t slot)
+{
+  auto& r = registry();
+  std::lock_guard<std::mutex> lock(r.mutex);
+  return r.names.at(slot);
+}
+
+inline tell::impl::Labels::Registry& tell::impl::Labels::registry()
+{
+  static Registry r;
+  return r;
+}
+
+template<typename Tag, typename Acc>
+tell::impl::Sharded<Tag,Acc>::Shard::Shard()
+{
+  auto& r = registry();
+  std::lock_guard<std::mutex> lock(r.mutex);
+  r.live.push_back(this);
+}
+
+template<typename Tag, typename Acc>
+tell::impl::Sharded<Tag,Acc>::Shard::~Shard()
+{
+  auto& r = registry();
+  std::lock_guard<std::mutex> lock(r.mutex);
+  for (const auto& p : stats) {
+    r.retired[p.first] += p.second;
+  }
+  for (std::size_t i = 0; i != slots.size(); ++i) {
+    if (used[i]) {
+      r.retired[Labels::name(i)] += slots[i];
+    }
+  }
+  r.live.erase(std::find(r.live.begin(), r.live.end(), this));
+}
+
+template<typename Tag, typename Acc>
+template<typename X>
+void tell::impl::Sharded<Tag,Acc>::Shard::update(Acc& acc, const X& x)
+{
+  const auto n = seq.load(std::memory_order_relaxed);
+  seq.store(n+1, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+  acc << x;
+  seq.store(n+2, std::memory_order_release);
+}
+
+template<typename Tag, typename Acc>
+Acc tell::impl::Sharded<Tag,Acc>::Shard::read(const Acc& acc) const
+{
+  Acc r;
+  unsigned s0, s1;
+  do {
+    s0 = seq.load(std::memory_order_acquire);
+    r = acc;
+    std::atomic_thread_fence(std::memory_order_acquire);
+    s1 = seq.load(std::memory_order_relaxed);
+  } while (s0 != s1 || (s0 & 1));
+  return r;
+}
+
+template<typename Tag, typename Acc>
+typename tell::impl::Sharded<Tag,Acc>::Registry&
+tell::impl::Sharded<Tag,Acc>::registry()
+{
+  static Registry r;
+  return r;
+}
+
+template<typename Tag, typename Acc>
+typename tell::impl::Sharded<Tag,Acc>::Shard&
+tell::impl::Sharded<Tag,Acc>::local()
+{
+  thread_local Shard s;
+  return s;
+}
+
+template<typename Tag, typename Acc>
+template<typename X>
+void tell::impl::Sharded<Tag,Acc>::add(const char* label, const X& x)
+{
+  auto& s = local();
+  auto i = s.stats.find(label);
+  if (i == s.stats.end()) {
+    // only changes of the map's shape are guarded against readers
+    std::lock_guard<std::mutex> lock(registry().mutex);
+    i = s.stats.emplace(label, Acc{}).first;
+  }
+  s.update(i->second, x);
+}
+
+template<typename Tag, typename Acc>
+template<typename X>
+void tell::impl::Sharded<Tag,Acc>::add(std::size_t slot, const X& x)
+{
+  auto& s = local();
+  if (s.used.size() <= slot || !s.used[slot]) {
+    std::lock_guard<std::mutex> lock(registry().mutex);
+    if (s.used.size() <= slot) {
+      s.slots.resize(slot+1);
+      s.used.resize(slot+1);
+    }
+    s.used[slot] = 1;
+  }
+  s.update(s.slots[slot], x);
+}
+
+template<typename Tag, typename Acc>
+std::map<std::string, Acc> tell::impl::Sharded<Tag,Acc>::merge()
+{
+  auto& r = registry();
+  std::lock_guard<std::mutex> lock(r.mutex);
+  auto m = r.retired;
+  for (const auto s : r.live) {
+    for (const auto& p : s->stats) {
+      m[p.first] += s->read(p.second);
+    }
+    for (std::size_t i = 0; i != s->slots.size(); ++i) {
+      if (s->used[i]) {
+	m[Labels::name(i)] += s->read(s->slots[i]);
+      }
+    }
+  }
+  return m;
+}
+
+template<typename T>
+tell::impl::Recycled<T>::Owner::~Owner()
+{
+  if (this->object) {
+    auto& r = registry();
+    std::lock_guard<std::mutex> lock(r.mutex);
+    r.free.push_back(this->object);
+  }
+}
+
+template<typename T>
+typename tell::impl::Recycled<T>::Registry& tell::impl::Recycled<T>::registry()
+{
+  static Registry r;
+  return r;
+}
+
+template<typename T>
+const typename tell::impl::Recycled<T>::Use& tell::impl::Recycled<T>::local()
+{
+  thread_local Owner owner;
+  if (!owner.object) {
+    auto& r = registry();
+    std::lock_guard<std::mutex> lock(r.mutex);
+    if (r.free.empty()) {
+      r.objects.push_back(std::make_unique<T>());
+      owner.object = r.objects.back().get();
+    }
+    else {
+      owner.object = r.free.back();
+      r.free.pop_back();
+    }
+    owner.tid = ++r.threads;
+  }
+  return owner;
+}
+
+template<typename T>
+template<typename F>
+void tell::impl::Recycled<T>::for_each(F f)
+{
+  auto& r = registry();
+  std::lock_guard<std::mutex> lock(r.mutex);
+  for (const auto& p : r.objects) {
+    f(*p);
+  }
+}
+
+template<typename P, typename Acc, typename Clock, typename Probe>
+tell::Timer<P,Acc,Clock,Probe>::Timer(const char* label)
+: label(label)
+{
+  start();
+}
+
+template<typename P, typename Acc, typename Clock, typename Probe>
+template<char... C>
+tell::Timer<P,Acc,Clock,Probe>::Timer(ct_string<C...> label)
+: label(label.c_str())
+, slot(impl::label_slot<ct_string<C...>>())
+{
+  start();
+}
+
+template<typename P, typename Acc, typename Clock, typename Probe>
+void tell::Timer<P,Acc,Clock,Probe>::start()
+{
+  if (on) {
+    probe.emplace();
+    t = Clock::now();
+  }
+}
+
+template<typename P, typename Acc, typename Clock, typename Probe>
+tell::Timer<P,Acc,Clock,Probe>::~Timer()
+{
+  if (!on) {
+    return;
+  }
+  const auto d = std::max(Clock::now() - t - clock_overhead<Clock>,
+			  Clock::duration::zero());
+  // stop the probe before the bookkeeping below can disturb it
+  typename Probe::Sample y{};
+  bool probed = false;
+  if constexpr (probing) {
+    probed = probe->stop(y);
+  }
+  impl::call_scope_hook(label, d);
+  const double x = std::chrono::duration_cast<P>(d).count();
+  if (slot == impl::Labels::none) {
+    Stats::add(label, x);
+  }
+  else {
+    Stats::add(slot, x);
+  }
+  if (!probed) {
+    return;
+  }
+  if constexpr (probing) {
+    if (slot == impl::Labels::none) {
+      Probe_stats::add(label, y);
+    }
+    else {
+      Probe_stats::add(slot, y);
+    }
+  }
+}
+
+template<typename P, typename Acc, typename Clock, typename Probe>
+std::map<std::string, Acc> tell::Timer<P,Acc,Clock,Probe>::stats()
+{
+  return Stats::merge();
+}
+
+template<typename P, typename Acc, typename Clock, typename Probe>
+std::map<std::string, typename Probe::Acc>
+tell::Timer<P,Acc,Clock,Probe>::probe_stats()
+{
+  if constexpr (probing) {
+    return Probe_stats::merge();
+  }
+  return {};
+}
+
+template<typename P, typename Acc, typename Clock, typename Probe>
+std::ostream&
+tell::Timer<P,Acc,Clock,Probe>::print_stats(std::ostream& ost, bool seqno)
+{
+  std::size_t i = 0;
+  const auto extra = probe_stats();
+  for (const auto& p : stats()) {
+    ost
+      << "timing for " << std::right << std::setw(10) << p.first;
+    if (seqno) {
+      ost
+	<< " (" << std::right << std::setw(2) << i++ << ')';
+    }
+    impl::print_stat(ost, p.second, precision<P>);
+    if constexpr (probing) {
+      const auto e = extra.find(p.first);
+      if (e != extra.end()) {
+	Probe::print(ost, e->second);
+      }
+    }
+    ost << '\n';
+  }
+  return ost;
+}
+
+template<std::size_t N, tell::Sampling S, typename P, typename Acc,
+  typename Clock>
+typename tell::Sampled_timer<N,S,P,Acc,Clock>::Calls&
+tell::Sampled_timer<N,S,P,Acc,Clock>::Calls::operator<<(double w)
+{
+  n += w;
+  return *this;
+}
+
+template<std::size_t N, tell::Sampling S, typename P, typename Acc,
+  typename Clock>
+typename tell::Sampled_timer<N,S,P,Acc,Clock>::Calls&
+tell::Sampled_timer<N,S,P,Acc,Clock>::Calls::operator+=(const Calls& c)
+{
+  n += c.n;
+  return *this;
+}
+
+template<std::size_t N, tell::Sampling S, typename P, typename Acc,
+  typename Clock>
+tell::Sampled_timer<N,S,P,Acc,Clock>::Sampled_timer(const char* label)
+: label(label)
+, cell(!impl::active(label) ? nullptr
+       : label == last_label ? last_cell
+       : (last_label = label, last_cell = &countdown(slot, label)))
+{
+}
+
+template<std::size_t N, tell::Sampling S, typename P, typename Acc,
+  typename Clock>
+template<char... C>
+tell::Sampled_timer<N,S,P,Acc,Clock>::Sampled_timer(ct_string<C...> label)
+: label(label.c_str())
+, slot(impl::label_slot<ct_string<C...>>())
+, cell(impl::active(this->label)
+       ? local<ct_string<C...>>(slot, this->label) : nullptr)
+{
+}
+
+template<std::size_t N, tell::Sampling S, typename P, typename Acc,
+  typename Clock>
+tell::Sampled_timer<N,S,P,Acc,Clock>::~Sampled_timer()
+{
+  if (!sampled) {
+    return;
+  }
+  const auto d = std::max(Clock::now() - t - clock_overhead<Clock>,
+			  Clock::duration::zero());
+  impl::call_scope_hook(label, d);
+  const double x = std::chrono::duration_cast<P>(d).count();
+  const double w = cell->rate;
+  if (slot == impl::Labels::none) {
+    Stats::add(label, x);
+    Call_stats::add(label, w);
+  }
+  else {
+    Stats::add(slot, x);
+    Call_stats::add(slot, w);
+  }
+  cell->rate = rate();
+  cell->left = next(cell->rate);
+}
+
+template<std::size_t N, tell::Sampling S, typename P, typename Acc,
+  typename Clock>
+typename tell::Sampled_timer<N,S,P,Acc,Clock>::Countdown&
+tell::Sampled_timer<N,S,P,Acc,Clock>::countdown(std::size_t slot,
+						const char* label)
+{
+  // deque and map keep their elements in place as they grow
+  thread_local std::deque<std::optional<Countdown>> slots;
+  thread_local std::map<const char*, Countdown> labels;
+  const auto first = [] {
+    const std::size_t n = rate();
+    return Countdown{next(n), n};
+  };
+  if (slot == impl::Labels::none) {
+    auto i = labels.find(label);
+    if (i == labels.end()) {
+      i = labels.emplace(label, first()).first;
+    }
+    return i->second;
+  }
+  if (slots.size() <= slot) {
+    slots.resize(slot + 1);
+  }
+  if (!slots[slot]) {
+    slots[slot] = first();
+  }
+  return *slots[slot];
+}
+
+template<std::size_t N, tell::Sampling S, typename P, typename Acc,
+  typename Clock>
+template<typename L>
+typename tell::Sampled_timer<N,S,P,Acc,Clock>::Countdown*
+tell::Sampled_timer<N,S,P,Acc,Clock>::local(std::size_t slot,
+					    const char* label)
+{
+  if (!cell_<L>) {
+    cell_<L> = &countdown(slot, label);
+  }
+  return cell_<L>;
+}
+
+template<std::size_t N, tell::Sampling S, typename P, typename Acc,
+  typename Clock>
+std::size_t tell::Sampled_timer<N,S,P,Acc,Clock>::next(std::size_t n)
+{
+  if constexpr (S == Sampling::every) {
+    return n;
+  }
+  else {
+    // geometric gap with mean n, from a per-thread xorshift generator
+    if (seed == 0) {
+      seed = reinterpret_cast<std::uintptr_t>(&seed) | 1;
+    }
+    seed ^= seed << 13;
+    seed ^= seed >> 7;
+    seed ^= seed << 17;
+    const double u = ((seed >> 11) + 0.5)*0x1p-53;
+    return n <= 1 ? 1
+      : 1 + static_cast<std::size_t>(std::log(u)/std::log1p(-1.0/n));
+  }
+}
+
+template<std::size_t N, tell::Sampling S, typename P, typename Acc,
+  typename Clock>
+void tell::Sampled_timer<N,S,P,Acc,Clock>::rate(std::size_t n)
+{
+  static_assert(N == 0, "sampling rate fixed at compile time");
+  rate_.store(std::max<std::size_t>(n, 1), std::memory_order_relaxed);
+}
+
+template<std::size_t N, tell::Sampling S, typename P, typename Acc,
+  typename Clock>
+std::size_t tell::Sampled_timer<N,S,P,Acc,Clock>::rate()
+{
+  if constexpr (N != 0) {
+    return N;
+  }
+  return rate_.load(std::memory_order_relaxed);
+}
+
+template<std::size_t N, tell::Sampling S, typename P, typename Acc,
+  typename Clock>
+std::map<std::string, Acc> tell::Sampled_timer<N,S,P,Acc,Clock>::stats()
+{
+  return Stats::merge();
+}
+
+template<std::size_t N, tell::Sampling S, typename P, typename Acc,
+  typename Clock>
+std::map<std::string, double> tell::Sampled_timer<N,S,P,Acc,Clock>::calls()
+{
+  std::map<std::string, double> m;
+  for (const auto& p : Call_stats::merge()) {
+    m[p.first] = p.second.n;
+  }
+  return m;
+}
+
+template<std::size_t N, tell::Sampling S, typename P, typename Acc,
+  typename Clock>
+std::ostream&
+tell::Sampled_timer<N,S,P,Acc,Clock>::print_stats(std::ostream& ost,
+						   bool seqno)
+{
+  std::size_t i = 0;
+  auto n = calls();
+  for (const auto& p : stats()) {
+    ost
+      << "timing for " << std::right << std::setw(10) << p.first;
+    if (seqno) {
+      ost
+	<< " (" << std::right << std::setw(2) << i++ << ')';
+    }
+    impl::print_stat(ost, p.second, precision<P>)
+      << " ~" << std::right << std::setw(12) << n[p.first] << " calls\n";
+  }
+  return ost;
+}
+
+template<const char* label>
+std::size_t tell::Counter<label>::slot()
+{
+  static const std::size_t slot = impl::Labels::add(label);
+  return slot;
+}
+
+template<const char* label>
+tell::Counter<label>::~Counter()
+{
+#if !defined(NDEBUG) || defined(TELL_COUNTERS)
+  if (!impl::active(label)) {
+    return;
+  }
+  if (!count) {
+    count = &cell(slot());
+  }
+  // single writer: a plain increment, no locked instruction
+  count->store(count->load(std::memory_order_relaxed) + 1,
+	       std::memory_order_relaxed);
+#endif
+}
+
+inline tell::Counter_base::Shard::Shard()
+{
+  auto& r = registry();
+  std::lock_guard<std::mutex> lock(r.mutex);
+  r.live.push_back(this);
+}
+
+inline tell::Counter_base::Shard::~Shard()
+{
+  auto& r = registry();
+  std::lock_guard<std::mutex> lock(r.mutex);
+  if (r.retired.size() < cells.size()) {
+    r.retired.resize(cells.size());
+  }
+  for (std::size_t i = 0; i != cells.size(); ++i) {
+    r.retired[i] += cells[i].load(std::memory_order_relaxed);
+  }
+  r.live.erase(std::find(r.live.begin(), r.live.end(), this));
+}
+
+inline tell::Counter_base::Registry& tell::Counter_base::registry()
+{
+  static Registry r;
+  return r;
+}
+
+inline tell::Counter_base::Shard& tell::Counter_base::local()
+{
+  thread_local Shard s;
+  return s;
+}
+
+inline tell::Counter_base::Cell& tell::Counter_base::cell(std::size_t slot)
+{
+  auto& s = local();
+  std::lock_guard<std::mutex> lock(registry().mutex);
+  while (s.cells.size() <= slot) {
+    s.cells.emplace_back(0);
+  }
+  return s.cells[slot];
+}
+
+inline std::map<std::string, std::size_t> tell::Counter_base::stats()
+{
+  auto& r = registry();
+  std::lock_guard<std::mutex> lock(r.mutex);
+  auto total = r.retired;
+  for (const auto s : r.live) {
+    if (total.size() < s->cells.size()) {
+      total.resize(s->cells.size());
+    }
+    for (std::size_t i = 0; i != s->cells.size(); ++i) {
+      total[i] += s->cells[i].load(std::memory_order_relaxed);
+    }
+  }
+  // labels with the same text count as one
+  std::map<std::string, std::size_t> m;
+  for (std::size_t i = 0; i != total.size(); ++i) {
+    if (total[i] != 0) {
+      m[impl::Labels::name(i)] += total[i];
+    }
+  }
+  return m;
+}
+
+inline std::ostream& tell::Counter_base::print_stats(std::ostream& ost)
+{
+#if !defined(NDEBUG) || defined(TELL_COUNTERS)
+  for (const auto& p : stats()) {
+    ost
+      << "count for " << std::right << std::setw(15) << p.first << ": "
+      << std::right << std::setw(10) << p.second
+      << '\n';
+  }
+#endif
+  return ost;
+}
+
+template<typename I>
+tell::Histo<I>& tell::Histo<I>::operator<<(I i)
+{
+  freq[i]++;
+  return *this;
+}
+
+template<typename I>
+tell::Histo<I>& tell::Histo<I>::operator<<(const std::vector<I>& v)
+{
+  for (auto i : v) {
+    *this << i;
+  }
+  return *this;
+}
+
+template<typename I>
+std::ostream& tell::Histo<I>::print(std::ostream& ost) const
 {
   for (const auto& f : freq) {
     ost << std::setw(5) << f.first << ": ";
@@ -445,6 +2250,260 @@ std::ostream& tell::Histo<I>::print(std::ostream& ost) const
   return ost;
 }
 
+template<typename I>
+std::map<I, std::size_t> tell::Histo<I>::bins() const
+{
+  return freq;
+}
+
+namespace tell::impl
+{
+  // one line per bin; bars are scaled to at most width characters, a
+  // bin with any samples gets at least one
+  template<typename K>
+    std::ostream&
+    print_bars(std::ostream& ost, const std::map<K, std::size_t>& bins,
+	       std::size_t width = 64)
+  {
+    std::size_t most = 0;
+    for (const auto& b : bins) {
+      most = std::max(most, b.second);
+    }
+    for (const auto& b : bins) {
+      const auto n = most <= width ? b.second
+	: std::max<std::size_t>(1, (b.second*width + most/2)/most);
+      ost
+	<< std::setw(5) << b.first << ": " << std::string(n, 'x')
+	<< ' ' << b.second << '\n';
+    }
+    return ost;
+  }
+
+  // counts bucket indices of n samples; the lanes hold separate counts
+  // so that runs of equal samples do not wait on each other's stores,
+  // if there are enough samples to pay for clearing and summing them
+  // and few enough buckets for them to stay in cache
+  template<typename I, typename F>
+    void count_bulk(std::size_t* freq, std::size_t size, const I* x,
+		    std::size_t n, F index)
+  {
+    constexpr std::size_t w = 4;
+    if (n < w*size || (1 << 12) < size) {
+      for (std::size_t i = 0; i != n; ++i) {
+	++freq[index(x[i])];
+      }
+      return;
+    }
+    std::vector<std::size_t> lanes(w*size);
+    const std::size_t nw = n - n%w;
+    for (std::size_t i = 0; i != nw; i += w) {
+      for (std::size_t j = 0; j != w; ++j) {
+	++lanes[j*size + index(x[i+j])];
+      }
+    }
+    for (std::size_t i = nw; i != n; ++i) {
+      ++lanes[index(x[i])];
+    }
+    for (std::size_t j = 0; j != w; ++j) {
+      for (std::size_t k = 0; k != size; ++k) {
+	freq[k] += lanes[j*size + k];
+      }
+    }
+  }
+}
+
+namespace tell::impl
+{
+  // small number of the calling thread, in order of first call
+  inline std::size_t thread_ordinal()
+  {
+    static std::atomic<std::size_t> next{0};
+    thread_local const std::size_t i
+      = next.fetch_add(1, std::memory_order_relaxed);
+    return i;
+  }
+}
+
+template<typename I>
+tell::Dense_histo<I>::Dense_histo(I lo, I hi)
+: lo(lo)
+, freq(static_cast<std::size_t>(hi - lo) + 3)
+{
+  assert(lo <= hi);
+}
+
+template<typename I>
+std::size_t tell::Dense_histo<I>::index(I i) const
+{
+  // branch free: out of range samples clamp to the end slots
+  const std::int64_t d = static_cast<std::int64_t>(i) - lo + 1;
+  const std::int64_t last = freq.size() - 1;
+  return d < 0 ? 0 : last < d ? last : d;
+}
+
+template<typename I>
+tell::Dense_histo<I>& tell::Dense_histo<I>::operator<<(I i)
+{
+  ++freq[index(i)];
+  return *this;
+}
+
+template<typename I>
+tell::Dense_histo<I>& tell::Dense_histo<I>::operator<<(const std::vector<I>& v)
+{
+  return add(v.data(), v.size());
+}
+
+template<typename I>
+tell::Dense_histo<I>& tell::Dense_histo<I>::add(const I* x, std::size_t n)
+{
+  impl::count_bulk(freq.data(), freq.size(), x, n,
+		   [this](I i) { return index(i); });
+  return *this;
+}
+
+template<typename I>
+std::map<I, std::size_t> tell::Dense_histo<I>::bins() const
+{
+  std::map<I, std::size_t> m;
+  for (std::size_t k = 1; k + 1 < freq.size(); ++k) {
+    if (freq[k]) {
+      m[static_cast<I>(lo + (k - 1))] = freq[k];
+    }
+  }
+  return m;
+}
+
+template<typename I>
+std::size_t tell::Dense_histo<I>::below() const
+{
+  return freq.front();
+}
+
+template<typename I>
+std::size_t tell::Dense_histo<I>::above() const
+{
+  return freq.back();
+}
+
+template<typename I>
+std::ostream& tell::Dense_histo<I>::print(std::ostream& ost) const
+{
+  if (below()) {
+    ost << "below " << lo << ": " << below() << '\n';
+  }
+  impl::print_bars(ost, bins());
+  if (above()) {
+    ost << "above " << lo + static_cast<I>(freq.size() - 3) << ": "
+	<< above() << '\n';
+  }
+  return ost;
+}
+
+template<typename I, int bits>
+std::size_t tell::Log_histo<I,bits>::index(I i)
+{
+  bool neg = false;
+  if constexpr (std::is_signed<I>::value) {
+    neg = i < 0;
+  }
+  const std::uint64_t v = neg ? std::uint64_t{0} - static_cast<std::uint64_t>(i)
+    : static_cast<std::uint64_t>(i);
+  std::size_t k = v;
+  if (sub <= v) {
+    const int shift = 63 - __builtin_clzll(v) - bits;
+    k = (shift+1)*sub + ((v >> shift) - sub);
+  }
+  return neg ? half - 1 - k : half + k;
+}
+
+template<typename I, int bits>
+I tell::Log_histo<I,bits>::key(std::size_t k)
+{
+  const bool neg = k < half;
+  k = neg ? half - 1 - k : k - half;
+  std::uint64_t v = k;
+  if (sub <= k) {
+    const int shift = k/sub - 1;
+    v = static_cast<std::uint64_t>(k%sub + sub) << shift;
+  }
+  return neg ? static_cast<I>(std::uint64_t{0} - v) : static_cast<I>(v);
+}
+
+template<typename I, int bits>
+tell::Log_histo<I,bits>& tell::Log_histo<I,bits>::operator<<(I i)
+{
+  ++freq[index(i)];
+  return *this;
+}
+
+template<typename I, int bits>
+tell::Log_histo<I,bits>&
+tell::Log_histo<I,bits>::operator<<(const std::vector<I>& v)
+{
+  return add(v.data(), v.size());
+}
+
+template<typename I, int bits>
+tell::Log_histo<I,bits>&
+tell::Log_histo<I,bits>::add(const I* x, std::size_t n)
+{
+  impl::count_bulk(freq.data(), freq.size(), x, n, &index);
+  return *this;
+}
+
+template<typename I, int bits>
+std::map<I, std::size_t> tell::Log_histo<I,bits>::bins() const
+{
+  std::map<I, std::size_t> m;
+  for (std::size_t k = 0; k != freq.size(); ++k) {
+    if (freq[k]) {
+      m[key(k)] += freq[k];
+    }
+  }
+  return m;
+}
+
+template<typename I, int bits>
+std::ostream& tell::Log_histo<I,bits>::print(std::ostream& ost) const
+{
+  return impl::print_bars(ost, bins());
+}
+
+template<typename I, int bits, std::size_t stripes>
+tell::Concurrent_histo<I,bits,stripes>&
+tell::Concurrent_histo<I,bits,stripes>::operator<<(I i)
+{
+  stripe[impl::thread_ordinal()%stripes].freq[Buckets::index(i)]
+    .fetch_add(1, std::memory_order_relaxed);
+  return *this;
+}
+
+template<typename I, int bits, std::size_t stripes>
+tell::Log_histo<I,bits> tell::Concurrent_histo<I,bits,stripes>::snapshot() const
+{
+  Buckets h;
+  for (const auto& s : stripe) {
+    for (std::size_t k = 0; k != h.freq.size(); ++k) {
+      h.freq[k] += s.freq[k].load(std::memory_order_relaxed);
+    }
+  }
+  return h;
+}
+
+template<typename I, int bits, std::size_t stripes>
+std::map<I, std::size_t> tell::Concurrent_histo<I,bits,stripes>::bins() const
+{
+  return snapshot().bins();
+}
+
+template<typename I, int bits, std::size_t stripes>
+std::ostream&
+tell::Concurrent_histo<I,bits,stripes>::print(std::ostream& ost) const
+{
+  return snapshot().print(ost);
+}
+
 template<typename T>
 std::ostream& tell::operator<<(std::ostream& ost, const std::vector<T>& v)
 {
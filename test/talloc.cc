@@ -0,0 +1,48 @@
+#include "tell/alloc.h"
+#include "tell/bench.h"
+#include <gtest/gtest.h>
+
+#include <memory>
+#include <sstream>
+#include <vector>
+
+using Timer = tell::Timer<std::chrono::nanoseconds, tell::Avg,
+			  std::chrono::steady_clock, tell::Alloc_counter>;
+
+TEST(AllocTest, Scopes)
+{
+  for (int i = 0; i != 10; ++i) {
+    Timer t("alloc");
+    std::vector<int> v(100);
+    auto p = std::make_unique<double>(i);
+    tell::do_not_optimize(v.data());
+    tell::do_not_optimize(p.get());
+  }
+  {
+    Timer t("none");
+  }
+  auto s = Timer::probe_stats();
+  ASSERT_DOUBLE_EQ(2, s["alloc"].allocations().first);
+  ASSERT_DOUBLE_EQ(400 + sizeof(double), s["alloc"].bytes().first);
+  ASSERT_DOUBLE_EQ(0, s["none"].allocations().first);
+  std::ostringstream os;
+  Timer::print_stats(os);
+  std::cout << os.str();
+  ASSERT_NE(std::string::npos, os.str().find("allocs/call"));
+}
+
+TEST(AllocTest, LexicalCast)
+{
+  {
+    Timer t("lexical_cast");
+    tell::do_not_optimize(tell::lexical_cast<std::string>(
+	"a word too long for the small string buffer"));
+  }
+  ASSERT_LT(0, Timer::probe_stats()["lexical_cast"].allocations().first);
+}
+
+int main(int argc, char* argv[])
+{
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
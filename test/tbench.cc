@@ -0,0 +1,169 @@
+// benchmarks of tell's own hot paths
+#include "tell/argct.h"
+#include "tell/bench.h"
+#include "tell/rand.h"
+#include "tell/util.h"
+#include "tell/vecn.h"
+#include <array>
+#include "tell/hash.h"
+#include <algorithm>
+#include <cmath>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+
+int main()
+{
+  using namespace tell;
+  std::cout << bench("Rand<int>", [X = Rand<int>{}]() mutable {
+      do_not_optimize(X());
+    }) << '\n';
+  std::cout << bench("Rand<double>", [Y = Rand<double>{0, 1}]() mutable {
+      do_not_optimize(Y());
+    }) << '\n';
+
+  std::array<double,3> u{1, 2, 3};
+  std::array<double,3> v{4, 5, 6};
+  std::cout << bench("vecn u+v", [&] {
+      do_not_optimize(u);
+      do_not_optimize(u + v);
+    }) << '\n';
+  std::cout << bench("vecn s*u", [&] {
+      do_not_optimize(u);
+      do_not_optimize(2.5*u);
+    }) << '\n';
+  std::cout << bench("vecn u*v", [&] {
+      do_not_optimize(u);
+      do_not_optimize(u*v);
+    }) << '\n';
+  std::cout << bench("vecn abs", [&] {
+      do_not_optimize(u);
+      do_not_optimize(abs(u));
+    }) << '\n';
+
+  std::cout << bench("lexical_cast<int>", [s = std::string("2911939")] {
+      do_not_optimize(lexical_cast<int>(s));
+    }) << '\n';
+  std::cout << bench("lexical_cast<std::string>", [] {
+      do_not_optimize(lexical_cast<std::string>(3.14));
+    }) << '\n';
+
+  std::cout << bench("hash_combine", [] {
+      std::size_t seed = 0;
+      hash_combine(seed, 42, 3.14, 'c');
+      do_not_optimize(seed);
+    }) << '\n';
+  std::cout << bench("hash<array<int,4>>", [a = std::array<int,4>{1, 2, 3, 4}] {
+      do_not_optimize(a);
+      do_not_optimize(std::hash<std::array<int,4>>{}(a));
+    }) << '\n';
+
+  std::vector<double> samples(1 << 22);
+  std::generate(samples.begin(), samples.end(), Rand<double>{0, 1});
+  std::cout << bench("Avg << x, 4M samples", [&samples] {
+      Avg a;
+      for (const auto x : samples) {
+	a << x;
+      }
+      do_not_optimize(a);
+    }) << '\n';
+  std::cout << bench("Avg << vector, 4M samples", [&samples] {
+      Avg a;
+      a << samples;
+      do_not_optimize(a);
+    }) << '\n';
+
+  std::vector<int> keys(1 << 20);
+  std::generate(keys.begin(), keys.end(), Rand<int>{0, 999});
+  std::cout << bench("Histo << vector, 1M keys", [&keys] {
+      Histo<int> h;
+      h << keys;
+      do_not_optimize(h);
+    }) << '\n';
+  std::cout << bench("Dense_histo << vector, 1M keys", [&keys] {
+      Dense_histo<int> h(0, 999);
+      h << keys;
+      do_not_optimize(h);
+    }) << '\n';
+  std::cout << bench("Log_histo << vector, 1M keys", [&keys] {
+      Log_histo<int> h;
+      h << keys;
+      do_not_optimize(h);
+    }) << '\n';
+
+  // evaluations to reach 1e-12, the ends of the bracket included for
+  // all but bisection
+  const auto evals = [](const char* name, auto f, double x0, double x1) {
+    int n[4] = {};
+    const auto count = [&f](int& n) {
+      return [&f, &n](double x) { ++n; return f(x); };
+    };
+    const double tol = 1e-12;
+    do_not_optimize(find_root(count(n[0]), x0, x1, tol));
+    do_not_optimize(find_root_brent(count(n[1]), x0, x1, tol));
+    do_not_optimize(find_root_illinois(count(n[2]), x0, x1, tol));
+    do_not_optimize(find_root_itp(count(n[3]), x0, x1, tol));
+    std::cout
+      << "evaluations for " << std::left << std::setw(14) << name << std::right
+      << " bisection" << std::setw(4) << n[0]
+      << " brent" << std::setw(4) << n[1]
+      << " illinois" << std::setw(4) << n[2]
+      << " itp" << std::setw(4) << n[3] << '\n';
+  };
+  evals("x^2-2", [](double x) { return x*x - 2; }, 0, 2);
+  evals("x^3-2x-5", [](double x) { return x*x*x - 2*x - 5; }, 2, 3);
+  evals("exp(x)-10", [](double x) { return std::exp(x) - 10; }, 0, 5);
+  evals("atan(x-1)", [](double x) { return std::atan(x - 1); }, -10, 10);
+  evals("(x-1/3)^5", [](double x) { return std::pow(x - 1.0/3, 5); }, 0, 1);
+  evals("step at 0.3", [](double x) { return x < 0.3 ? -1.0 : 1.0; }, 0, 1);
+  std::cout << bench("find_root x^2-2", [] {
+      do_not_optimize(find_root([](double x) { return x*x - 2; }, 0.0, 2.0, 1e-12));
+    }) << '\n';
+  std::cout << bench("find_root_itp x^2-2", [] {
+      do_not_optimize(find_root_itp([](double x) { return x*x - 2; }, 0.0, 2.0, 1e-12));
+    }) << '\n';
+
+  // p(x) = a for 64k values of a, p odd of degree 9: one call of p per
+  // problem against one call per 8 problems with a loop over lanes
+  const auto p = [](double x) {
+    const double x2 = x*x;
+    return x*(1 + x2*(1.0/3 + x2*(1.0/5 + x2*(1.0/7 + x2/9))));
+  };
+  std::vector<double> as(1 << 16);
+  std::generate(as.begin(), as.end(), Rand<double>{1, 99});
+  std::cout << bench("find_root_itp, 64k problems", [&as, p] {
+      for (const auto a : as) {
+	do_not_optimize(find_root_itp([a, p](double x) { return p(x) - a; },
+				      0.0, 3.0, 1e-12));
+      }
+    }) << '\n';
+  std::cout << bench("find_roots<8>, 64k problems", [&as, p] {
+      constexpr std::size_t W = 8;
+      std::array<double,W> x0;
+      std::array<double,W> x1;
+      x0.fill(0);
+      x1.fill(3);
+      for (std::size_t k = 0; k != as.size(); k += W) {
+	const double* a = &as[k];
+	do_not_optimize(find_roots([a, p](const std::array<double,W>& x) {
+	      std::array<double,W> y;
+	      for (std::size_t i = 0; i != W; ++i) {
+		y[i] = p(x[i]) - a[i];
+	      }
+	      return y;
+	    }, x0, x1, 1e-12));
+      }
+    }) << '\n';
+
+  const char* argv[] = {"tbench", "-n", "7", "-f", "-s", "text"};
+  std::cout << bench("argct::handle", [&argv] {
+      using namespace tell::argct;
+      auto getopt = handle(6, argv,
+			   start
+			   << decl("-n"_o, "integer", 42)
+			   << decl("-f"_o, "boolean flag", false)
+			   << decl("-s"_o, "string", std::string("hello")));
+      do_not_optimize(getopt);
+    }) << '\n';
+}
@@ -0,0 +1,58 @@
+// cost of release-build counters: per-thread relaxed cells against a
+// shared atomic counter, from one and from several threads; with an
+// argument, that many increments per thread only, as a quick check
+#define TELL_COUNTERS
+#include "tell/util.h"
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <thread>
+#include <vector>
+
+const char hot[] = "hot";
+
+std::size_t n = 100'000'000;
+std::atomic<std::size_t> shared{0};
+
+template<typename F>
+double ns_per_op(int threads, F f)
+{
+  using Clock = std::chrono::steady_clock;
+  const auto t = Clock::now();
+  std::vector<std::thread> pool;
+  for (int k = 0; k != threads; ++k) {
+    pool.emplace_back([f]{
+	for (std::size_t i = 0; i != n; ++i) {
+	  f();
+	}
+      });
+  }
+  for (auto& p : pool) {
+    p.join();
+  }
+  const std::chrono::duration<double, std::nano> d = Clock::now() - t;
+  return d.count()/n;
+}
+
+int main(int argc, char* argv[])
+{
+  if (1 < argc) {
+    n = std::strtoul(argv[1], nullptr, 10);
+  }
+  const int threads = std::max(2u, std::thread::hardware_concurrency());
+  for (int k : {1, threads}) {
+    const double c = ns_per_op(k, []{ tell::Counter<hot> c; });
+    const double a = ns_per_op(k, []{
+	shared.fetch_add(1, std::memory_order_relaxed);
+      });
+    std::cout
+      << std::setw(3) << k << " thread(s): Counter "
+      << std::setw(8) << c << "ns, shared atomic "
+      << std::setw(8) << a << "ns per increment\n";
+  }
+  tell::Counter_base::print_stats(std::cout);
+  const auto expected = (1 + threads)*n;
+  return tell::Counter_base::stats()["hot"] == expected ? 0 : 1;
+}
@@ -0,0 +1,37 @@
+#include "tell/cpu.h"
+#include "tell/bench.h"
+#include <gtest/gtest.h>
+
+#include <sstream>
+#include <thread>
+
+using Timer = tell::Timer<std::chrono::microseconds, tell::Avg,
+			  std::chrono::steady_clock, tell::Cpu_time>;
+
+TEST(CpuTest, BusyAndBlocked)
+{
+  {
+    Timer t("busy");
+    for (const auto s = std::chrono::steady_clock::now();
+	 std::chrono::steady_clock::now() - s < std::chrono::milliseconds(20); ) {
+      tell::clobber_memory();
+    }
+  }
+  {
+    Timer t("blocked");
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+  }
+  auto s = Timer::probe_stats();
+  ASSERT_LT(0.5, s["busy"].ratio());
+  ASSERT_GT(0.2, s["blocked"].ratio());
+  std::ostringstream os;
+  Timer::print_stats(os);
+  std::cout << os.str();
+  ASSERT_NE(std::string::npos, os.str().find("cpu/wall"));
+}
+
+int main(int argc, char* argv[])
+{
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,43 @@
+#include "tell/fault.h"
+#include "tell/bench.h"
+#include <gtest/gtest.h>
+
+#include <memory>
+#include <sstream>
+
+using Timer = tell::Timer<std::chrono::nanoseconds, tell::Avg,
+			  std::chrono::steady_clock, tell::Fault_counter>;
+
+TEST(FaultTest, FirstTouch)
+{
+  constexpr std::size_t n = std::size_t{64} << 20;
+  const std::unique_ptr<char[]> p(new char[n]);
+  {
+    Timer t("touch");
+    for (std::size_t i = 0; i < n; i += 4096) {
+      p[i] = 1;
+    }
+    tell::do_not_optimize(p.get());
+  }
+  {
+    Timer t("retouch");
+    for (std::size_t i = 0; i < n; i += 4096) {
+      p[i] = 2;
+    }
+    tell::do_not_optimize(p.get());
+  }
+  auto s = Timer::probe_stats();
+  ASSERT_LT(1000, s["touch"].minor().first);
+  ASSERT_LT(n/2, s["touch"].rss().first);
+  ASSERT_GT(100, s["retouch"].minor().first);
+  std::ostringstream os;
+  Timer::print_stats(os);
+  std::cout << os.str();
+  ASSERT_NE(std::string::npos, os.str().find("minor-faults/call"));
+}
+
+int main(int argc, char* argv[])
+{
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
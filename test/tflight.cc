@@ -0,0 +1,129 @@
+#include "tell/flight.h"
+#include <gtest/gtest.h>
+
+#include <set>
+#include <sstream>
+#include <thread>
+
+using Timer = tell::Flight_timer<4, 2>;
+
+namespace
+{
+  void request(int id, std::chrono::milliseconds work)
+  {
+    Timer t("request", std::chrono::milliseconds(1), id);
+    {
+      Timer t("parse");
+      {
+	Timer t("lex");
+      }
+    }
+    {
+      Timer t("db");
+      std::this_thread::sleep_for(work);
+    }
+  }
+}
+
+TEST(FlightTest, Slow)
+{
+  request(1, std::chrono::milliseconds(0));
+  request(2, std::chrono::milliseconds(2));
+  std::ostringstream os;
+  Timer::dump(os);
+  std::cout << os.str();
+  const auto s = os.str();
+  ASSERT_EQ(std::string::npos, s.find("tag 1 "));
+  ASSERT_EQ(0u, s.find("slow scope request"));
+  ASSERT_NE(std::string::npos, s.find("tag 2 "));
+  // the last depth scopes ended within the request, oldest first
+  const auto lex = s.find("\n    lex");
+  const auto parse = s.find("\n  parse");
+  const auto db = s.find("\n  db");
+  ASSERT_NE(std::string::npos, lex);
+  ASSERT_LT(lex, parse);
+  ASSERT_LT(parse, db);
+  ASSERT_EQ(2u, Timer::stats()["lex"].count());
+}
+
+TEST(FlightTest, Ring)
+{
+  for (int i = 3; i != 6; ++i) {
+    request(i, std::chrono::milliseconds(2));
+  }
+  std::ostringstream os;
+  Timer::dump(os);
+  ASSERT_EQ(std::string::npos, os.str().find("tag 3 "));
+  ASSERT_NE(std::string::npos, os.str().find("tag 4 "));
+  ASSERT_NE(std::string::npos, os.str().find("tag 5 "));
+}
+
+TEST(FlightTest, Switch)
+{
+  tell::Switch::enable("switched", false);
+  {
+    Timer t("switched", std::chrono::milliseconds(0));
+  }
+  tell::Switch::enable("switched");
+  ASSERT_EQ(0u, Timer::stats().count("switched"));
+  std::ostringstream os;
+  Timer::dump(os);
+  ASSERT_EQ(std::string::npos, os.str().find("switched"));
+  // a thread whose scopes are all switched off takes no recorder
+  using T = tell::Flight_timer<2, 2>;
+  tell::Switch::enable("switched", false);
+  std::thread([]{ T t("switched", std::chrono::microseconds(0)); }).join();
+  tell::Switch::enable("switched");
+  std::thread([]{
+      T t("on", std::chrono::microseconds(0));
+      std::this_thread::sleep_for(std::chrono::microseconds(10));
+    }).join();
+  std::ostringstream ot;
+  T::dump(ot);
+  ASSERT_NE(std::string::npos, ot.str().find("slow scope on"));
+  ASSERT_NE(std::string::npos, ot.str().find(" thread 1\n"));
+}
+
+TEST(FlightTest, Slots)
+{
+  using tell::operator""_S;
+  {
+    Timer t("slotted"_S, std::chrono::microseconds(0), 7);
+    std::this_thread::sleep_for(std::chrono::microseconds(10));
+  }
+  ASSERT_EQ(1u, Timer::stats()["slotted"].count());
+  std::ostringstream os;
+  Timer::dump(os);
+  ASSERT_NE(std::string::npos, os.str().find("slow scope slotted"));
+  ASSERT_NE(std::string::npos, os.str().find("tag 7 "));
+}
+
+TEST(FlightTest, Recycle)
+{
+  // threads one after another share a recorder, each with a number of
+  // its own
+  using T = tell::Flight_timer<4, 8>;
+  for (int i = 0; i != 5; ++i) {
+    std::thread t([i]{
+	T t("recycled", std::chrono::microseconds(0), i);
+	std::this_thread::sleep_for(std::chrono::microseconds(10));
+      });
+    t.join();
+  }
+  std::ostringstream os;
+  T::dump(os);
+  std::istringstream is(os.str());
+  std::set<std::string> tids;
+  for (std::string line; std::getline(is, line); ) {
+    const auto t = line.find(" thread ");
+    ASSERT_NE(std::string::npos, t);
+    tids.insert(line.substr(t));
+  }
+  ASSERT_EQ(5u, tids.size());
+}
+
+int main(int argc, char* argv[])
+{
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,127 @@
+#include "tell/metrics.h"
+#include <gtest/gtest.h>
+
+#include <cstdio>
+#include <fstream>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+
+namespace
+{
+  using T = tell::Timer<std::chrono::nanoseconds>;
+
+  // value of the sample line starting with prefix, -1 if there is none
+  double value(const std::string& text, const std::string& prefix)
+  {
+    std::istringstream is(text);
+    for (std::string line; std::getline(is, line); ) {
+      if (line.compare(0, prefix.size(), prefix) == 0) {
+	return std::stod(line.substr(prefix.size()));
+      }
+    }
+    return -1;
+  }
+}
+
+TEST(MetricsTest, Windows)
+{
+  std::mutex m;
+  tell::Histo<int> h;
+  tell::Metrics_export::add<T>("t");
+  tell::Metrics_export::add("h", h, m);
+  for (int i = 0; i != 10; ++i) {
+    T t("metrics");
+  }
+  {
+    std::lock_guard<std::mutex> lock(m);
+    h << 1 << 1 << 2;
+  }
+  std::ostringstream w1;
+  tell::Metrics_export::write(w1);
+  const auto calls = "tell_timer_calls{timer=\"t\",label=\"metrics\"} ";
+  ASSERT_EQ(10, value(w1.str(), calls));
+  ASSERT_EQ(2, value(w1.str(), "tell_histo_count{histo=\"h\",value=\"1\"} "));
+  ASSERT_NE(std::string::npos, w1.str().find("# TYPE tell_timer_calls gauge\n"));
+  ASSERT_EQ(0u, w1.str().rfind("# EOF\n") + 6 - w1.str().size());
+
+  for (int i = 0; i != 3; ++i) {
+    T t("metrics");
+  }
+  std::ostringstream w2;
+  tell::Metrics_export::write(w2);
+  ASSERT_EQ(3, value(w2.str(), calls));
+  ASSERT_EQ(0, value(w2.str(), "tell_histo_count{histo=\"h\",value=\"1\"} "));
+  tell::Metrics_export::remove("h");
+  tell::Metrics_export::remove("t");
+}
+
+TEST(MetricsTest, Sampled)
+{
+  using S = tell::Sampled_timer<100, tell::Sampling::every,
+				std::chrono::nanoseconds>;
+  tell::Metrics_export::add<S>("s");
+  for (int i = 0; i != 10000; ++i) {
+    S t("sampled");
+  }
+  std::ostringstream w;
+  tell::Metrics_export::write(w);
+  ASSERT_EQ(10000, value(w.str(), "tell_timer_calls{timer=\"s\",label=\"sampled\"} "));
+  const double seconds
+    = value(w.str(), "tell_timer_seconds{timer=\"s\",label=\"sampled\"} ");
+  const auto& a = S::stats()["sampled"];
+  ASSERT_NEAR(a().first*1e-9*10000, seconds, 1e-12);
+  tell::Metrics_export::remove("s");
+}
+
+TEST(MetricsTest, Window)
+{
+  using W = tell::Timer<std::chrono::nanoseconds, tell::Window_avg<>>;
+  using D = tell::Timer<std::chrono::nanoseconds, tell::Decayed_avg<>>;
+  tell::Metrics_export::add<W>("w");
+  tell::Metrics_export::add<D>("d");
+  for (int i = 0; i != 5; ++i) {
+    W t("windowed");
+    D u("decayed");
+  }
+  const auto calls = "tell_timer_window_calls{timer=\"w\",label=\"windowed\"} ";
+  const auto weight = "tell_timer_decayed_calls{timer=\"d\",label=\"decayed\"} ";
+  // the window as it is, not the change since the last write
+  for (int i = 0; i != 2; ++i) {
+    std::ostringstream w;
+    tell::Metrics_export::write(w);
+    ASSERT_EQ(5, value(w.str(), calls));
+    ASSERT_NEAR(5, value(w.str(), weight), 0.01);
+    const auto& a = W::stats()["windowed"].window();
+    ASSERT_NEAR(a().first*1e-9*5,
+		value(w.str(), "tell_timer_window_seconds{timer=\"w\",label=\"windowed\"} "),
+		1e-12);
+    ASSERT_LT(0, value(w.str(), "tell_timer_decayed_seconds{timer=\"d\",label=\"decayed\"} "));
+  }
+  tell::Metrics_export::remove("w");
+  tell::Metrics_export::remove("d");
+}
+
+TEST(MetricsTest, File)
+{
+  const std::string path = "tmetrics.prom";
+  tell::Metrics_export::start(path, std::chrono::milliseconds(1));
+  {
+    T t("file");
+  }
+  std::this_thread::sleep_for(std::chrono::milliseconds(20));
+  tell::Metrics_export::stop();
+  std::ifstream in(path);
+  std::ostringstream text;
+  text << in.rdbuf();
+  ASSERT_NE(std::string::npos, text.str().find("# EOF\n"));
+  ASSERT_FALSE(std::ifstream(path + ".tmp"));
+  std::remove(path.c_str());
+}
+
+int main(int argc, char **argv)
+{
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,72 @@
+#include "tell/mutex.h"
+#include <gtest/gtest.h>
+
+#include <mutex>
+#include <sstream>
+#include <thread>
+#include <vector>
+
+using Mutex = tell::Profiled_mutex<>;
+
+TEST(MutexTest, Contention)
+{
+  Mutex m("queue");
+  long sum = 0;
+  std::vector<std::thread> pool;
+  for (int k = 0; k != 4; ++k) {
+    pool.emplace_back([&m, &sum]{
+	for (int i = 0; i != 1000; ++i) {
+	  std::lock_guard<Mutex> lock(m);
+	  ++sum;
+	}
+      });
+  }
+  for (auto& t : pool) {
+    t.join();
+  }
+  {
+    std::unique_lock<Mutex> lock(m, std::try_to_lock);
+    ASSERT_TRUE(lock.owns_lock());
+    std::this_thread::sleep_for(std::chrono::milliseconds(2));
+  }
+  m.lock();
+  std::thread waiter([&m, &sum]{
+      std::lock_guard<Mutex> lock(m);
+      ++sum;
+    });
+  std::this_thread::sleep_for(std::chrono::milliseconds(5));
+  m.unlock();
+  waiter.join();
+  ASSERT_EQ(4001, sum);
+  auto s = Mutex::stats()["queue"];
+  ASSERT_EQ(4003u, s.acquisitions);
+  ASSERT_LE(1u, s.contended);
+  ASSERT_LE(2e6, s.hold.first.max());
+  ASSERT_LE(2e6, s.wait.first.max());
+  ASSERT_EQ(4003u, s.wait.second.count());
+  std::ostringstream os;
+  Mutex::print_stats(os);
+  std::cout << os.str();
+  ASSERT_NE(std::string::npos, os.str().find("contended"));
+}
+
+TEST(MutexTest, Switch)
+{
+  Mutex m("switched");
+  tell::Switch::enable(false);
+  {
+    std::lock_guard<Mutex> lock(m);
+  }
+  tell::Switch::enable();
+  ASSERT_EQ(0u, Mutex::stats().count("switched"));
+  {
+    std::lock_guard<Mutex> lock(m);
+  }
+  ASSERT_EQ(1u, Mutex::stats()["switched"].acquisitions);
+}
+
+int main(int argc, char* argv[])
+{
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,39 @@
+#include "tell/perf.h"
+#include <gtest/gtest.h>
+
+#include <sstream>
+#include <vector>
+
+using Timer = tell::Timer<std::chrono::nanoseconds, tell::Avg,
+			  std::chrono::steady_clock, tell::Perf_counters>;
+
+TEST(PerfTest, Scopes)
+{
+  std::vector<int> v(1 << 16);
+  for (int i = 0; i != 10; ++i) {
+    Timer t("sum");
+    for (auto& x : v) {
+      x += i;
+    }
+  }
+  ASSERT_EQ(1u, Timer::stats().size());
+  std::ostringstream os;
+  Timer::print_stats(os);
+  std::cout << os.str();
+  if (tell::Perf_counters::available()) {
+    const auto s = Timer::probe_stats()["sum"];
+    ASSERT_LT(0, s.ipc());
+    ASSERT_NE(std::string::npos, os.str().find("IPC"));
+  }
+  else {
+    // denied, e.g. in a container: time only
+    ASSERT_TRUE(Timer::probe_stats().empty());
+    ASSERT_EQ(std::string::npos, os.str().find("IPC"));
+  }
+}
+
+int main(int argc, char* argv[])
+{
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,63 @@
+#include "tell/profile.h"
+#include <gtest/gtest.h>
+
+#include <sstream>
+#include <thread>
+
+#include <unistd.h>
+
+using Profile = tell::Profile<std::chrono::milliseconds>;
+
+void parse()
+{
+  Profile p("parse");
+  usleep(10000);
+}
+
+void request()
+{
+  Profile p("request");
+  usleep(10000);
+  parse();
+  parse();
+}
+
+TEST(ProfileTest, Paths)
+{
+  std::thread t(request);
+  request();
+  t.join();
+  auto stats = Profile::stats();
+  const Profile::Path r{"request"};
+  const Profile::Path rp{"request", "parse"};
+  ASSERT_EQ(2u, stats.size());
+  ASSERT_EQ(2u, stats[r].calls);
+  ASSERT_EQ(4u, stats[rp].calls);
+  ASSERT_NEAR(60, stats[r].inclusive, 15);
+  ASSERT_NEAR(20, stats[r].exclusive, 10);
+  ASSERT_NEAR(40, stats[rp].exclusive, 10);
+  std::ostringstream os;
+  Profile::print_collapsed(os);
+  ASSERT_EQ(0u, os.str().find("request "));
+  ASSERT_NE(std::string::npos, os.str().find("\nrequest;parse "));
+  Profile::print_stats(std::cout);
+}
+
+TEST(ProfileTest, Switch)
+{
+  tell::Switch::enable("parse", false);
+  {
+    Profile p("switch");
+    parse();
+  }
+  tell::Switch::enable("parse");
+  auto stats = Profile::stats();
+  ASSERT_EQ(1u, stats[{"switch"}].calls);
+  ASSERT_EQ(0u, stats.count({"switch", "parse"}));
+}
+
+int main(int argc, char* argv[])
+{
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,66 @@
+#include "tell/report.h"
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <sstream>
+#include <thread>
+#include <vector>
+
+TEST(AsyncReportTest, Lines)
+{
+  std::ostringstream os;
+  tell::Async_report::start(os, std::chrono::milliseconds(1));
+  std::vector<std::thread> pool;
+  for (int k = 0; k != 4; ++k) {
+    pool.emplace_back([]{
+	for (int i = 0; i != 100; ++i) {
+	  tell::Stop_watch<std::chrono::nanoseconds> w("async");
+	}
+      });
+  }
+  for (auto& t : pool) {
+    t.join();
+  }
+  tell::Async_report::stop();
+  std::size_t lines = 0;
+  std::istringstream is(os.str());
+  for (std::string line; std::getline(is, line); ++lines) {
+    ASSERT_EQ(0u, line.find("timing for        async: "));
+    ASSERT_EQ('s', line.back());
+  }
+  ASSERT_EQ(400u - tell::Async_report::dropped(), lines);
+}
+
+TEST(AsyncReportTest, Stop)
+{
+  // producers racing stop() have their records written or dropped, none
+  // is left queued for the next start
+  std::ostringstream os;
+  tell::Async_report::start(os, std::chrono::milliseconds(1));
+  std::atomic<bool> stopped{false};
+  std::vector<std::thread> pool;
+  for (int k = 0; k != 4; ++k) {
+    pool.emplace_back([&stopped]{
+	while (!stopped) {
+	  tell::Stop_watch<std::chrono::nanoseconds> w("stop");
+	}
+      });
+  }
+  std::this_thread::sleep_for(std::chrono::milliseconds(5));
+  tell::Async_report::stop();
+  stopped = true;
+  for (auto& t : pool) {
+    t.join();
+  }
+  ASSERT_LT(0u, tell::Async_report::dropped());
+  std::ostringstream next;
+  tell::Async_report::start(next, std::chrono::milliseconds(1));
+  tell::Async_report::stop();
+  ASSERT_EQ("", next.str());
+}
+
+int main(int argc, char* argv[])
+{
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,173 @@
+#include "tell/shm.h"
+#include <gtest/gtest.h>
+
+#include <sstream>
+#include <string>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+namespace
+{
+  const std::string name = "/tshm-" + std::to_string(getpid());
+  // longer than a label in the segment
+  const char* const long_label
+    = "a label too long to be kept in full in the shared segment";
+}
+
+TEST(ShmTest, Workers)
+{
+  using T = tell::Timer<std::chrono::microseconds>;
+  ASSERT_TRUE(tell::Shm_metrics::attach(name, 0));
+  tell::Shm_metrics::add<T>("t");
+  for (int i = 0; i != 10; ++i) {
+    T t("parent");
+    T u(long_label);
+  }
+  tell::Shm_metrics::publish();
+
+  // another worker process
+  const auto pid = fork();
+  ASSERT_LE(0, pid);
+  if (pid == 0) {
+    // a timer of its own, T's statistics are the parent's copy
+    using C = tell::Timer<std::chrono::nanoseconds>;
+    tell::Shm_metrics::attach(name, 1);
+    tell::Shm_metrics::add<C>("t");
+    for (int i = 0; i != 5; ++i) {
+      C t("child");
+    }
+    tell::Shm_metrics::start(std::chrono::milliseconds(1));
+    tell::Shm_metrics::stop();
+    _exit(0);
+  }
+  int status;
+  waitpid(pid, &status, 0);
+
+  const auto w = tell::Shm_metrics::workers(name);
+  ASSERT_EQ(2u, w.size());
+  auto a = tell::Shm_metrics::aggregate(name);
+  using K = tell::Shm_metrics::Kind;
+  ASSERT_EQ(10, (a[{K::timer, "t", "parent"}].count));
+  ASSERT_EQ(15, (a[{K::timer, "t", "parent"}].count
+		 + a[{K::timer, "t", "child"}].count));
+  std::ostringstream os;
+  tell::Shm_metrics::print(os, name);
+  std::cout << os.str();
+  ASSERT_NE(std::string::npos, os.str().find("child"));
+}
+
+TEST(ShmTest, Restart)
+{
+  // worker 0 comes back: its region holds the 10 "parent" scopes
+  using T = tell::Timer<std::chrono::microseconds, tell::Avg,
+			std::chrono::steady_clock>;
+  ASSERT_TRUE(tell::Shm_metrics::attach(name, 0));
+  tell::Shm_metrics::add<T>("t");
+  for (int i = 0; i != 3; ++i) {
+    T t("parent");
+    T u(long_label);
+  }
+  tell::Shm_metrics::publish();
+  using K = tell::Shm_metrics::Kind;
+  auto a = tell::Shm_metrics::aggregate(name);
+  ASSERT_EQ(13, (a[{K::timer, "t", "parent"}].count));
+  ASSERT_EQ(13, (a[{K::timer, "t", std::string(long_label, 48)}].count));
+  tell::Shm_metrics::detach();
+  shm_unlink(name.c_str());
+}
+
+TEST(ShmTest, Window)
+{
+  using W = tell::Timer<std::chrono::microseconds, tell::Window_avg<>>;
+  using D = tell::Timer<std::chrono::microseconds, tell::Decayed_avg<>>;
+  const auto other = name + "-window";
+  ASSERT_TRUE(tell::Shm_metrics::attach(other, 0));
+  tell::Shm_metrics::add<W>("w");
+  tell::Shm_metrics::add<D>("d");
+  for (int i = 0; i != 4; ++i) {
+    W t("windowed");
+    D u("decayed");
+  }
+  tell::Shm_metrics::publish();
+  using K = tell::Shm_metrics::Kind;
+  auto a = tell::Shm_metrics::aggregate(other);
+  ASSERT_EQ(4, (a[{K::timer, "w", "windowed"}].count));
+  ASSERT_NEAR(4, (a[{K::timer, "d", "decayed"}].count), 0.01);
+  tell::Shm_metrics::detach();
+  shm_unlink(other.c_str());
+}
+
+TEST(ShmTest, Owner)
+{
+  // a number held by a running worker is refused until it exits
+  const auto other = name + "-owner";
+  int ready[2];
+  int done[2];
+  ASSERT_EQ(0, pipe(ready));
+  ASSERT_EQ(0, pipe(done));
+  const auto pid = fork();
+  ASSERT_LE(0, pid);
+  if (pid == 0) {
+    close(done[1]);
+    char c = tell::Shm_metrics::attach(other, 3);
+    if (write(ready[1], &c, 1) == 1) {
+      while (read(done[0], &c, 1) == 1) {
+      }
+    }
+    _exit(0);
+  }
+  close(done[0]);
+  char c = 0;
+  ASSERT_EQ(1, read(ready[0], &c, 1));
+  ASSERT_TRUE(c);
+  ASSERT_FALSE(tell::Shm_metrics::attach(other, 3));
+  ASSERT_TRUE(tell::Shm_metrics::attach(other, 4));
+  close(done[1]);
+  int status;
+  waitpid(pid, &status, 0);
+  ASSERT_TRUE(tell::Shm_metrics::attach(other, 3));
+  tell::Shm_metrics::detach();
+  shm_unlink(other.c_str());
+}
+
+TEST(ShmTest, Layout)
+{
+  // a segment of another size or version is neither used nor changed
+  const auto other = name + "-layout";
+  int fd = shm_open(other.c_str(), O_RDWR | O_CREAT, 0600);
+  ASSERT_LE(0, fd);
+  ASSERT_EQ(0, ftruncate(fd, 4096));
+  ASSERT_FALSE(tell::Shm_metrics::attach(other, 0));
+  ASSERT_TRUE(tell::Shm_metrics::workers(other).empty());
+  struct stat st;
+  ASSERT_EQ(0, fstat(fd, &st));
+  ASSERT_EQ(4096, st.st_size);
+  close(fd);
+  shm_unlink(other.c_str());
+
+  ASSERT_TRUE(tell::Shm_metrics::attach(other, 0));
+  tell::Shm_metrics::detach();
+  // the version follows the magic number at the start
+  fd = shm_open(other.c_str(), O_RDWR, 0600);
+  ASSERT_LE(0, fd);
+  ASSERT_EQ(0, fstat(fd, &st));
+  void* p = mmap(nullptr, st.st_size, PROT_READ | PROT_WRITE, MAP_SHARED,
+		 fd, 0);
+  close(fd);
+  ASSERT_NE(MAP_FAILED, p);
+  ++static_cast<std::uint64_t*>(p)[1];
+  munmap(p, st.st_size);
+  ASSERT_FALSE(tell::Shm_metrics::attach(other, 0));
+  ASSERT_TRUE(tell::Shm_metrics::workers(other).empty());
+  shm_unlink(other.c_str());
+}
+
+int main(int argc, char* argv[])
+{
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
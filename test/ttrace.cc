@@ -0,0 +1,87 @@
+#include "tell/trace.h"
+#include <gtest/gtest.h>
+
+#include <set>
+#include <sstream>
+#include <string>
+#include <thread>
+
+std::size_t count(const std::string& s, const std::string& what)
+{
+  std::size_t n = 0;
+  for (auto i = s.find(what); i != std::string::npos; i = s.find(what, i+1)) {
+    ++n;
+  }
+  return n;
+}
+
+TEST(TraceTest, Events)
+{
+  tell::Trace::start();
+  std::thread t([]{
+      for (int i = 0; i != 10; ++i) {
+	tell::Timer<> t("worker");
+      }
+    });
+  t.join();
+  {
+    tell::Timer<> t("quote\"d");
+  }
+  tell::Trace::stop();
+  {
+    tell::Timer<> t("untraced");
+  }
+  std::ostringstream os;
+  tell::Trace::write(os);
+  const auto json = os.str();
+  ASSERT_EQ(0u, json.find("{\"traceEvents\":["));
+  ASSERT_EQ(11u, count(json, "\"ph\":\"X\""));
+  ASSERT_EQ(10u, count(json, "\"name\":\"worker\""));
+  ASSERT_EQ(1u, count(json, "\"name\":\"quote\\\"d\""));
+  ASSERT_EQ(0u, count(json, "untraced"));
+}
+
+TEST(TraceTest, Wrap)
+{
+  tell::Trace::start();
+  std::thread t([]{
+      for (std::size_t i = 0; i != tell::Trace::capacity + 10; ++i) {
+	tell::Timer<> t("wrap");
+      }
+    });
+  t.join();
+  tell::Trace::stop();
+  std::ostringstream os;
+  tell::Trace::write(os);
+  ASSERT_EQ(tell::Trace::capacity - 1, count(os.str(), "\"name\":\"wrap\""));
+}
+
+TEST(TraceTest, Recycle)
+{
+  // threads one after another share a ring, each with a tid of its own
+  tell::Trace::start();
+  for (int i = 0; i != 20; ++i) {
+    std::thread t([]{
+	tell::Timer<> t("recycled");
+      });
+    t.join();
+  }
+  tell::Trace::stop();
+  std::ostringstream os;
+  tell::Trace::write(os);
+  const auto json = os.str();
+  ASSERT_EQ(20u, count(json, "\"name\":\"recycled\""));
+  std::set<std::string> tids;
+  for (auto i = json.find("recycled"); i != std::string::npos;
+       i = json.find("recycled", i+1)) {
+    const auto t = json.find("\"tid\":", i);
+    tids.insert(json.substr(t, json.find('}', t) - t));
+  }
+  ASSERT_EQ(20u, tids.size());
+}
+
+int main(int argc, char* argv[])
+{
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -1,9 +1,14 @@
 #include "tell/util.h"
+#include "tell/bench.h"
 #include <gtest/gtest.h>
 
+#include <array>
 #include <iostream>
 #include <cmath>
 #include <cassert>
+#include <sstream>
+#include <thread>
+#include <vector>
 
 #include <unistd.h>
 
@@ -39,6 +44,416 @@ TEST(StopWatchTest, Basics)
   
 }
 
+TEST(TimerTest, Threads)
+{
+  std::vector<std::thread> pool;
+  for (int k = 0; k != 8; ++k) {
+    pool.emplace_back([]{
+	for (int i = 0; i != 1000; ++i) {
+	  tell::Timer<std::chrono::nanoseconds> t("worker");
+	}
+      });
+  }
+  for (auto& t : pool) {
+    t.join();
+  }
+  const auto stats = tell::Timer<std::chrono::nanoseconds>::stats();
+  ASSERT_EQ(1u, stats.size());
+  ASSERT_EQ(8000u, stats.at("worker").count());
+  std::ostringstream os;
+  tell::Timer<std::chrono::nanoseconds>::print_stats(os);
+  ASSERT_NE(std::string::npos, os.str().find("worker"));
+}
+
+TEST(AvgTest, Merge)
+{
+  tell::Avg a, b, c;
+  for (int i = 0; i != 10; ++i) {
+    (i < 4 ? a : b) << i;
+    c << i;
+  }
+  a += b;
+  ASSERT_NEAR(c().first, a().first, 1e-12);
+  ASSERT_NEAR(c().second, a().second, 1e-12);
+  ASSERT_EQ(10u, a.count());
+  ASSERT_EQ(0, a.min());
+  ASSERT_EQ(9, a.max());
+}
+
+TEST(AvgTest, Bulk)
+{
+  std::vector<double> v;
+  tell::Avg a, b;
+  for (int i = 0; i != 10007; ++i) {
+    v.push_back(std::sin(i)*100 + 1e6);
+    a << v.back();
+  }
+  b << v;
+  ASSERT_EQ(a.count(), b.count());
+  ASSERT_NEAR(a().first, b().first, 1e-6);
+  ASSERT_NEAR(a().second, b().second, 1e-6);
+  ASSERT_EQ(a.min(), b.min());
+  ASSERT_EQ(a.max(), b.max());
+}
+
+TEST(LatencyHistoTest, Quantiles)
+{
+  tell::Latency_histo h, g;
+  for (int i = 1; i <= 10000; ++i) {
+    (i % 2 ? h : g) << i;
+  }
+  h += g;
+  ASSERT_EQ(10000u, h.count());
+  ASSERT_DOUBLE_EQ(10000, h.max());
+  ASSERT_DOUBLE_EQ(5000.5, h.mean());
+  for (double q : {0.5, 0.9, 0.99, 0.999}) {
+    ASSERT_NEAR(q*10000, h.quantile(q), q*10000/32);
+  }
+  ASSERT_DOUBLE_EQ(10000, h.quantile(1));
+}
+
+TEST(LatencyHistoTest, Timer)
+{
+  using T = tell::Timer<std::chrono::nanoseconds,
+			tell::Both<tell::Avg, tell::Latency_histo>>;
+  for (int i = 0; i != 100; ++i) {
+    T t("histo");
+  }
+  std::ostringstream os;
+  T::print_stats(os);
+  ASSERT_NE(std::string::npos, os.str().find("p99.9"));
+  ASSERT_NE(std::string::npos, os.str().find("+-"));
+}
+
+TEST(TimerTest, Labels)
+{
+  using namespace tell;
+  using T = Timer<std::chrono::nanoseconds>;
+  for (int i = 0; i != 10; ++i) {
+    T a("dense"_S);
+    T b("dense");
+    T c("other"_S);
+  }
+  const auto stats = T::stats();
+  ASSERT_EQ(1u, stats.count("dense"));
+  ASSERT_EQ(1u, stats.count("other"));
+}
+
+TEST(ClockTest, Tsc)
+{
+  using namespace std::chrono;
+  const auto s = steady_clock::now();
+  const auto t = tell::Tsc_clock::now();
+  usleep(20000);
+  const auto ds = duration_cast<microseconds>(steady_clock::now() - s);
+  const auto dt = duration_cast<microseconds>(tell::Tsc_clock::now() - t);
+  ASSERT_NEAR(ds.count(), dt.count(), 0.05*ds.count());
+}
+
+TEST(ClockTest, Timer)
+{
+  using namespace std::chrono;
+  using T = tell::Timer<nanoseconds, tell::Avg, tell::Tsc_clock>;
+  using C = tell::Timer<milliseconds, tell::Avg, tell::Coarse_clock>;
+  for (int i = 0; i != 100; ++i) {
+    T t("tsc");
+  }
+  {
+    C c("coarse");
+    usleep(20000);
+  }
+  ASSERT_LE(0, T::stats()["tsc"]().first);
+  ASSERT_NEAR(20, C::stats()["coarse"]().first, 10);
+  tell::Stop_watch<nanoseconds, tell::Tsc_clock> w("tsc");
+}
+
+TEST(SampledTimerTest, Every)
+{
+  using T = tell::Sampled_timer<100, tell::Sampling::every,
+				std::chrono::nanoseconds>;
+  for (int i = 0; i != 100000; ++i) {
+    T t("every");
+  }
+  ASSERT_EQ(1000u, T::stats()["every"].count());
+  ASSERT_DOUBLE_EQ(100000, T::calls()["every"]);
+}
+
+TEST(SampledTimerTest, Interleaved)
+{
+  using namespace tell;
+  using T = tell::Sampled_timer<2, tell::Sampling::every,
+				std::chrono::microseconds>;
+  for (int i = 0; i != 1000; ++i) {
+    T a("a");
+    T b("b");
+    T c("c"_S);
+    T d("d"_S);
+  }
+  for (const char* l : {"a", "b", "c", "d"}) {
+    ASSERT_EQ(500u, T::stats()[l].count());
+    ASSERT_DOUBLE_EQ(1000, T::calls()[l]);
+  }
+}
+
+TEST(SampledTimerTest, Random)
+{
+  using T = tell::Sampled_timer<0, tell::Sampling::random,
+				std::chrono::nanoseconds>;
+  T::rate(50);
+  for (int i = 0; i != 100000; ++i) {
+    T t("random");
+  }
+  ASSERT_NEAR(2000, T::stats()["random"].count(), 300);
+  ASSERT_NEAR(100000, T::calls()["random"], 15000);
+  std::ostringstream os;
+  T::print_stats(os);
+  ASSERT_NE(std::string::npos, os.str().find("calls"));
+}
+
+TEST(SampledTimerTest, Rate)
+{
+  using T = tell::Sampled_timer<0, tell::Sampling::random,
+				std::chrono::nanoseconds>;
+  T::rate(1);
+  for (int i = 0; i != 1000; ++i) {
+    T t("rate");
+  }
+  // the gap scheduled at rate 1 still counts once after the change
+  T::rate(1000000);
+  for (int i = 0; i != 10; ++i) {
+    T t("rate");
+  }
+  ASSERT_EQ(1001u, T::stats()["rate"].count());
+  ASSERT_DOUBLE_EQ(1001, T::calls()["rate"]);
+}
+
+TEST(DenseHistoTest, Bulk)
+{
+  std::vector<int> v;
+  for (int i = 0; i != 1001; ++i) {
+    v.push_back(i%12 - 1);
+  }
+  tell::Dense_histo<int> h(0, 9);
+  h << v << 5;
+  ASSERT_EQ(84u, h.below());
+  ASSERT_EQ(83u, h.above());
+  auto b = h.bins();
+  ASSERT_EQ(10u, b.size());
+  ASSERT_EQ(84u, b[0]);
+  ASSERT_EQ(84u, b[5]);
+  std::ostringstream os;
+  h.print(os);
+  ASSERT_NE(std::string::npos, os.str().find("    5: " + std::string(64, 'x')
+					     + " 84\n"));
+}
+
+TEST(LogHistoTest, Buckets)
+{
+  tell::Log_histo<long> h;
+  const std::vector<long> v = {0, 1, 3, 4, 5, 6, 7, 8, 9, 10, 1000, -5, -1000};
+  h << v;
+  auto b = h.bins();
+  ASSERT_EQ(1u, b[0]);
+  ASSERT_EQ(1u, b[3]);
+  ASSERT_EQ(1u, b[4]);
+  ASSERT_EQ(1u, b[7]);
+  ASSERT_EQ(2u, b[8]);// 8 and 9
+  ASSERT_EQ(1u, b[10]);
+  ASSERT_EQ(1u, b[896]);// 1000 in [896, 1024)
+  ASSERT_EQ(1u, b[-5]);
+  ASSERT_EQ(1u, b[-896]);
+  ASSERT_EQ(-896, b.begin()->first);
+}
+
+TEST(ConcurrentHistoTest, Threads)
+{
+  tell::Concurrent_histo<long> h;
+  std::vector<std::thread> pool;
+  for (int k = 0; k != 12; ++k) {
+    pool.emplace_back([&h]{
+	for (long i = 0; i != 10000; ++i) {
+	  h << i%10;
+	}
+      });
+  }
+  for (auto& t : pool) {
+    t.join();
+  }
+  auto b = h.bins();
+  ASSERT_EQ(12000u, b[0]);
+  ASSERT_EQ(24000u, b[8]);// 8 and 9
+}
+
+TEST(WindowAvgTest, Expiry)
+{
+  tell::Window_avg<4, 10> w;
+  w << 1 << 3;
+  ASSERT_EQ(2u, w.count());
+  ASSERT_DOUBLE_EQ(2, w().first);
+  std::this_thread::sleep_for(std::chrono::milliseconds(60));
+  ASSERT_EQ(0u, w.count());
+  w << 5;
+  tell::Window_avg<4, 10> v;
+  v << 7;
+  w += v;
+  ASSERT_EQ(2u, w.count());
+  ASSERT_DOUBLE_EQ(6, w().first);
+}
+
+TEST(DecayedAvgTest, Decay)
+{
+  tell::Decayed_avg<20> d;
+  for (int i = 0; i != 100; ++i) {
+    d << 1;
+  }
+  ASSERT_DOUBLE_EQ(1, d().first);
+  std::this_thread::sleep_for(std::chrono::milliseconds(100));
+  ASSERT_GT(10, d.weight());
+  for (int i = 0; i != 100; ++i) {
+    d << 3;
+  }
+  ASSERT_LT(2.8, d().first);
+  tell::Decayed_avg<20> e;
+  e += d;
+  ASSERT_DOUBLE_EQ(d().first, e().first);
+}
+
+TEST(WindowAvgTest, Timer)
+{
+  using T = tell::Timer<std::chrono::nanoseconds, tell::Window_avg<>>;
+  for (int i = 0; i != 100; ++i) {
+    T t("window");
+  }
+  ASSERT_EQ(100u, T::stats()["window"].count());
+  using D = tell::Timer<std::chrono::nanoseconds, tell::Decayed_avg<>>;
+  {
+    D t("decayed");
+  }
+  std::ostringstream os;
+  D::print_stats(os);
+  ASSERT_NE(std::string::npos, os.str().find("decayed"));
+}
+
+TEST(SwitchTest, Scopes)
+{
+  using T = tell::Timer<std::chrono::nanoseconds>;
+  const auto scopes = [] {
+    T a("switch a");
+    T b("switch b");
+  };
+  scopes();
+  tell::Switch::enable(false);
+  scopes();
+  ASSERT_FALSE(tell::Switch::enabled("switch a"));
+  tell::Switch::enable(true);
+  tell::Switch::enable("switch b", false);
+  scopes();
+  ASSERT_TRUE(tell::Switch::enabled("switch a"));
+  ASSERT_FALSE(tell::Switch::enabled("switch b"));
+  tell::Switch::enable("switch b");
+  scopes();
+  ASSERT_EQ(3u, T::stats()["switch a"].count());
+  ASSERT_EQ(2u, T::stats()["switch b"].count());
+}
+
+namespace
+{
+  // counts evaluations as the solvers' Guard
+  struct Evals
+  {
+    Evals() { ++n; }
+    static int n;
+  };
+  int Evals::n = 0;
+
+  // spare: evaluations allowed beyond bisection's
+  template<typename Solve>
+  int check_roots(int spare, Solve solve)
+  {
+    const double tol = 1e-10;
+    int n = 0;
+    const auto f = [](double x) { return x*x - 2; };
+    const auto g = [](double x) { return x*x*x - 2*x - 5; };
+    const auto h = [](double x) { return std::atan(x - 1); };
+    const auto k = [](double x) { return x < 0.3 ? -1.0 : 1.0; };
+    const auto q = [](double x) { return std::pow(x - 1.0/3, 5); };
+    Evals::n = 0;
+    EXPECT_NEAR(std::sqrt(2.0), solve(f, 0.0, 2.0, tol), tol);
+    EXPECT_NEAR(2.0945514815423265, solve(g, 2.0, 3.0, tol), tol);
+    EXPECT_NEAR(1.0, solve(h, -10.0, 10.0, tol), tol);
+    n += Evals::n;
+    // a step and a flat zero: at most bisection's 34 steps and spare
+    Evals::n = 0;
+    EXPECT_NEAR(0.3, solve(k, 0.0, 1.0, tol), tol);
+    EXPECT_LE(Evals::n, 34 + spare);
+    Evals::n = 0;
+    EXPECT_NEAR(1.0/3, solve(q, 0.0, 1.0, tol), tol);
+    EXPECT_LE(Evals::n, 34 + spare);
+    return n;
+  }
+}
+
+TEST(FindRootTest, Solvers)
+{
+  const int bisection = check_roots(0, [](auto f, double x0, double x1, double tol) {
+      return tell::find_root<Evals>(f, x0, x1, tol);
+    });
+  const int brent = check_roots(4, [](auto f, double x0, double x1, double tol) {
+      return tell::find_root_brent<Evals>(f, x0, x1, tol);
+    });
+  const int illinois = check_roots(6, [](auto f, double x0, double x1, double tol) {
+      return tell::find_root_illinois<Evals>(f, x0, x1, tol);
+    });
+  const int itp = check_roots(3, [](auto f, double x0, double x1, double tol) {
+      return tell::find_root_itp<Evals>(f, x0, x1, tol);
+    });
+  ASSERT_LT(brent, bisection/2);
+  ASSERT_LT(illinois, bisection/2);
+  ASSERT_LT(itp, bisection/2);
+  ASSERT_NEAR(std::sqrt(2.0), tell::find_root_itp([](double x) { return x*x - 2; },
+						  0.0, 2.0, 1e-6), 1e-6);
+}
+
+TEST(FindRootTest, Batch)
+{
+  const double tol = 1e-10;
+  // x^2 - a per lane, the last lane hits its zero exactly
+  const std::array<double,4> a{2, 3, 50, 0.25};
+  const auto f = [&a](const std::array<double,4>& x) {
+    std::array<double,4> y;
+    for (std::size_t i = 0; i != 4; ++i) {
+      y[i] = x[i]*x[i] - a[i];
+    }
+    return y;
+  };
+  Evals::n = 0;
+  const auto x = tell::find_roots<Evals>(f, std::array<double,4>{0, 1, 0, 0},
+					 std::array<double,4>{2, 2, 10, 1}, tol);
+  int most = 0;
+  for (std::size_t i = 0; i != 4; ++i) {
+    ASSERT_NEAR(std::sqrt(a[i]), x[i], tol);
+    int n = 0;
+    const double z = tell::find_root_itp([&](double x) { ++n; return x*x - a[i]; },
+					 i == 1 ? 1.0 : 0.0, i == 2 ? 10.0 : i == 3 ? 1.0 : 2.0, tol);
+    ASSERT_EQ(z, x[i]);
+    most = std::max(most, n);
+  }
+  // lockstep: as many calls as the slowest lane needs evaluations
+  ASSERT_EQ(most, Evals::n);
+}
+
+TEST(BenchTest, Empty)
+{
+  // the loop is optimised away and never takes sample_time
+  int x = 0;
+  tell::Bench_config c;
+  c.warmup = std::chrono::milliseconds(1);
+  c.samples = 3;
+  const auto r = tell::bench("empty", [&x]{ ++x; }, c);
+  ASSERT_LT(0u, r.iterations);
+  ASSERT_EQ(3u, r.samples + r.rejected);
+}
+
 int main(int argc, char* argv[])
 {
   ::tell::Stop_watch w;